@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/rcu.h"
 
 /* A block device. */
 struct block
@@ -88,13 +89,18 @@ block_get_by_name (const char *name)
 {
   struct list_elem *e;
 
+  rcu_read_lock ();
   for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
        e = list_next (e))
     {
       struct block *block = list_entry (e, struct block, list_elem);
       if (!strcmp (name, block->name))
-        return block;
+        {
+          rcu_read_unlock ();
+          return block;
+        }
     }
+  rcu_read_unlock ();
 
   return NULL;
 }
@@ -192,7 +198,6 @@ block_register (const char *name, enum block_type type,
   if (block == NULL)
     PANIC ("Failed to allocate memory for block device descriptor");
 
-  list_push_back (&all_blocks, &block->list_elem);
   strlcpy (block->name, name, sizeof block->name);
   block->type = type;
   block->size = size;
@@ -201,6 +206,10 @@ block_register (const char *name, enum block_type type,
   block->read_cnt = 0;
   block->write_cnt = 0;
 
+  /* Publish the device only once it is initialized, because
+     block_get_by_name() reads all_blocks without a lock. */
+  rcu_list_push_back (&all_blocks, &block->list_elem);
+
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
   printf (")");
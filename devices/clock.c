@@ -0,0 +1,133 @@
+#include "devices/clock.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* High-resolution monotonic clock.
+
+   The clock source is the processor's time-stamp counter (TSC), a
+   64-bit register that counts processor cycles and takes only a
+   few cycles to read.  clock_init() measures its frequency
+   against the timer ticks and works out a fixed-point factor
+   that converts cycles into nanoseconds with two 32-bit
+   multiplications and shifts.
+
+   This assumes that the TSC runs at a constant rate and that the
+   TSCs of all the processors are in step, as they are on recent
+   processors and under the usual emulators.  Without a TSC, the
+   clock only has the resolution of a timer tick. */
+
+/* Timer ticks over which to measure the TSC. */
+#define CALIBRATION_TICKS 5
+
+/* Bit in EDX of CPUID leaf 1 for TSC support. */
+#define CPUID_TSC (1u << 4)
+
+static bool precise;            /* Has the TSC been calibrated? */
+static uint64_t cycles_base;    /* TSC at the end of calibration. */
+static int64_t ns_base;         /* clock_ns() at the same point. */
+static uint32_t ns_mult;        /* Cycles to nanoseconds: multiply... */
+static int ns_shift;            /* ...by NS_MULT, shift right by NS_SHIFT. */
+
+static bool have_tsc (void);
+
+/* Calibrates the time-stamp counter against the timer, which
+   must already be running.  Interrupts must be on. */
+void
+clock_init (void)
+{
+  uint64_t start_cycles, end_cycles, hz;
+  int64_t start;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  if (!have_tsc ())
+    {
+      printf ("Clock: no time-stamp counter, using timer ticks.\n");
+      return;
+    }
+
+  /* Count cycles from one tick boundary to another. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  start_cycles = clock_cycles ();
+  start = timer_ticks ();
+  while (timer_ticks () - start < CALIBRATION_TICKS)
+    barrier ();
+  end_cycles = clock_cycles ();
+  hz = (end_cycles - start_cycles) * TIMER_FREQ / CALIBRATION_TICKS;
+  ASSERT (hz > 0);
+
+  /* Pick the largest shift for which the multiplier fits in 32
+     bits, for the best precision. */
+  for (ns_shift = 32; ns_shift > 0; ns_shift--)
+    if (((uint64_t) NS_PER_SEC << ns_shift) / hz <= UINT32_MAX)
+      break;
+  ns_mult = ((uint64_t) NS_PER_SEC << ns_shift) / hz;
+
+  /* Continue from the tick-based clock, so that clock_ns() never
+     goes backward. */
+  ns_base = (start + CALIBRATION_TICKS) * (NS_PER_SEC / TIMER_FREQ);
+  cycles_base = end_cycles;
+  precise = true;
+
+  printf ("Clock: %'"PRIu64" Hz time-stamp counter.\n", hz);
+}
+
+/* Returns true if clock_ns() has better than timer tick
+   resolution, that is, if the time-stamp counter has been
+   calibrated. */
+bool
+clock_is_precise (void)
+{
+  return precise;
+}
+
+/* Returns the current value of the time-stamp counter. */
+uint64_t
+clock_cycles (void)
+{
+  uint32_t lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns the number of nanoseconds since the OS booted.  The
+   value never decreases.  Interrupts need not be turned on. */
+int64_t
+clock_ns (void)
+{
+  if (!precise)
+    return timer_ticks () * (NS_PER_SEC / TIMER_FREQ);
+  return ns_base + clock_cycles_to_ns (clock_cycles () - cycles_base);
+}
+
+/* Converts CYCLES of the time-stamp counter into nanoseconds.
+   Each 32-bit half is multiplied separately, so that no product
+   overflows 64 bits.  Returns 0 if the clock is not precise. */
+int64_t
+clock_cycles_to_ns (uint64_t cycles)
+{
+  uint32_t lo = cycles;
+  uint32_t hi = cycles >> 32;
+
+  if (!precise)
+    return 0;
+  return (((uint64_t) hi * ns_mult) << (32 - ns_shift))
+         + (((uint64_t) lo * ns_mult) >> ns_shift);
+}
+
+/* Returns true if the processor has a time-stamp counter. */
+static bool
+have_tsc (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_TSC) != 0;
+}
@@ -0,0 +1,17 @@
+#ifndef DEVICES_CLOCK_H
+#define DEVICES_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Nanoseconds per second. */
+#define NS_PER_SEC (1000 * 1000 * 1000)
+
+void clock_init (void);
+bool clock_is_precise (void);
+
+uint64_t clock_cycles (void);
+int64_t clock_cycles_to_ns (uint64_t cycles);
+int64_t clock_ns (void);
+
+#endif /* devices/clock.h */
@@ -0,0 +1,258 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Local Advanced Programmable Interrupt Controller (APIC).
+   Every processor has one.  We use it to send inter-processor
+   interrupts (IPIs), to start application processors (APs), and
+   as the timer interrupt source on the APs, which do not see the
+   8254 PIT interrupt.  Refer to [IA32-v3a] chapter 10 "Advanced
+   Programmable Interrupt Controller (APIC)" for details. */
+
+/* Local APIC register offsets, in bytes. */
+#define LAPIC_ID        0x020   /* Local APIC ID. */
+#define LAPIC_TPR       0x080   /* Task priority. */
+#define LAPIC_EOI       0x0b0   /* End of interrupt. */
+#define LAPIC_SVR       0x0f0   /* Spurious interrupt vector. */
+#define LAPIC_ICR_LO    0x300   /* Interrupt command, low half. */
+#define LAPIC_ICR_HI    0x310   /* Interrupt command, high half. */
+#define LAPIC_LVT_TIMER 0x320   /* Local vector table: timer. */
+#define LAPIC_TIMER_ICR 0x380   /* Timer initial count. */
+#define LAPIC_TIMER_CCR 0x390   /* Timer current count. */
+#define LAPIC_TIMER_DCR 0x3e0   /* Timer divide configuration. */
+
+/* LAPIC_SVR bits. */
+#define SVR_ENABLE      0x100   /* APIC software enable. */
+
+/* LAPIC_ICR_LO bits. */
+#define ICR_FIXED       0x00000 /* Fixed delivery mode. */
+#define ICR_INIT        0x00500 /* INIT delivery mode. */
+#define ICR_STARTUP     0x00600 /* STARTUP delivery mode. */
+#define ICR_PENDING     0x01000 /* Delivery status: send pending. */
+#define ICR_ASSERT      0x04000 /* Level: assert. */
+#define ICR_LEVEL       0x08000 /* Trigger mode: level. */
+
+/* LAPIC_LVT_TIMER bits. */
+#define LVT_MASKED      0x10000 /* Interrupt masked. */
+#define LVT_PERIODIC    0x20000 /* Periodic timer mode. */
+
+/* LAPIC_TIMER_DCR value: divide the bus clock by 16. */
+#define TIMER_DIV_16    0x3
+
+/* Virtual address of the local APIC registers.  Every CPU's
+   local APIC appears at the same physical address, and each CPU
+   sees its own. */
+static volatile uint32_t *lapic;
+
+/* Timer counts per timer tick, at a divisor of 16.
+   Initialized by calibrate_timer(). */
+static uint32_t counts_per_tick;
+
+static intr_handler_func lapic_timer_interrupt;
+static void map_registers (uint32_t paddr);
+static void calibrate_timer (void);
+static void init_local (void);
+static void wait_for_delivery (void);
+
+/* Reads the local APIC register at byte offset REG. */
+static inline uint32_t
+lapic_read (unsigned reg)
+{
+  return lapic[reg / sizeof *lapic];
+}
+
+/* Writes VALUE to the local APIC register at byte offset REG. */
+static inline void
+lapic_write (unsigned reg, uint32_t value)
+{
+  lapic[reg / sizeof *lapic] = value;
+}
+
+/* Initializes the bootstrap processor's local APIC, whose
+   registers are at physical address PADDR, and calibrates the
+   local APIC timer against the 8254 timer.  Must be called with
+   interrupts on, after timer_init(), and before any user page
+   directory is created, because it adds a kernel mapping. */
+void
+lapic_bsp_init (uint32_t paddr)
+{
+  ASSERT (intr_get_level () == INTR_ON);
+
+  map_registers (paddr);
+  intr_register_ext (LAPIC_TIMER_VEC, lapic_timer_interrupt,
+                     "Local APIC Timer");
+  init_local ();
+  calibrate_timer ();
+}
+
+/* Initializes the calling application processor's local APIC
+   and starts its periodic timer at TIMER_FREQ. */
+void
+lapic_ap_init (void)
+{
+  ASSERT (lapic != NULL);
+
+  init_local ();
+  lapic_timer_start ();
+}
+
+/* Starts the calling CPU's local APIC timer interrupting
+   TIMER_FREQ times per second. */
+void
+lapic_timer_start (void)
+{
+  lapic_write (LAPIC_TIMER_DCR, TIMER_DIV_16);
+  lapic_write (LAPIC_LVT_TIMER, LVT_PERIODIC | LAPIC_TIMER_VEC);
+  lapic_write (LAPIC_TIMER_ICR, counts_per_tick);
+}
+
+/* Stops the calling CPU's local APIC timer. */
+void
+lapic_timer_stop (void)
+{
+  lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+  lapic_write (LAPIC_TIMER_ICR, 0);
+}
+
+/* Returns the local APIC ID of the calling CPU. */
+uint8_t
+lapic_id (void)
+{
+  return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Signals the end of the interrupt being serviced to the local
+   APIC. */
+void
+lapic_eoi (void)
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sends interrupt VEC to the CPU whose local APIC ID is
+   APIC_ID. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec)
+{
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, ICR_FIXED | ICR_ASSERT | vec);
+  wait_for_delivery ();
+}
+
+/* Sends an INIT IPI to the CPU whose local APIC ID is APIC_ID,
+   resetting it into the wait-for-STARTUP state. */
+void
+lapic_send_init (uint8_t apic_id)
+{
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  wait_for_delivery ();
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, ICR_INIT | ICR_LEVEL);
+  wait_for_delivery ();
+}
+
+/* Sends a STARTUP IPI to the CPU whose local APIC ID is APIC_ID,
+   which makes it begin executing in real mode at physical
+   address PADDR.  PADDR must be page-aligned and below 1 MB. */
+void
+lapic_send_startup (uint8_t apic_id, uint32_t paddr)
+{
+  ASSERT (paddr % PGSIZE == 0 && paddr < 0x100000);
+
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, ICR_STARTUP | (paddr >> PGBITS));
+  wait_for_delivery ();
+}
+
+/* Local APIC timer interrupt handler, only used on the APs. */
+static void
+lapic_timer_interrupt (struct intr_frame *args)
+{
+  profile_sample (args);
+  thread_tick ();
+}
+
+/* Maps the page of local APIC registers at physical address
+   PADDR into the kernel's address space, at the same virtual
+   address, with caching disabled. */
+static void
+map_registers (uint32_t paddr)
+{
+  uint32_t *pd = init_page_dir;
+  void *vaddr = (void *) paddr;
+  uint32_t *pt;
+
+  ASSERT (pg_ofs (vaddr) == 0);
+  ASSERT (vaddr >= ptov (init_ram_pages * PGSIZE));
+
+  if (pd[pd_no (vaddr)] == 0)
+    {
+      pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      pd[pd_no (vaddr)] = pde_create (pt);
+    }
+  pt = pde_get_pt (pd[pd_no (vaddr)]);
+  pt[pt_no (vaddr)] = paddr | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+  asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+
+  lapic = vaddr;
+}
+
+/* Counts how many local APIC timer counts elapse during one
+   8254 timer tick. */
+static void
+calibrate_timer (void)
+{
+  int64_t start;
+
+  lapic_write (LAPIC_TIMER_DCR, TIMER_DIV_16);
+  lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+
+  /* Start counting down right after a tick and stop at the
+     next one. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  lapic_write (LAPIC_TIMER_ICR, UINT32_MAX);
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  counts_per_tick = UINT32_MAX - lapic_read (LAPIC_TIMER_CCR);
+  lapic_write (LAPIC_TIMER_ICR, 0);
+
+  printf ("Local APIC timer: %'"PRIu32" counts per tick.\n",
+          counts_per_tick);
+}
+
+/* Enables the calling CPU's local APIC and lets it accept
+   interrupts of every priority.  The local vector table entries
+   for LINT0 and LINT1 are left as the BIOS set them up, so that
+   the 8259A PICs keep interrupting the bootstrap processor. */
+static void
+init_local (void)
+{
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+  lapic_write (LAPIC_TPR, 0);
+  lapic_eoi ();
+}
+
+/* Waits for the last IPI sent by this CPU to be accepted. */
+static void
+wait_for_delivery (void)
+{
+  while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+    barrier ();
+}
@@ -0,0 +1,22 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdint.h>
+
+/* Interrupt vectors used by the local APIC.  They are above the
+   vectors used for exceptions, the 8259A PICs and system calls. */
+#define LAPIC_TIMER_VEC    0xf0   /* Local APIC timer. */
+#define LAPIC_RESCHED_VEC  0xf1   /* Reschedule inter-processor interrupt. */
+#define LAPIC_SPURIOUS_VEC 0xff   /* Spurious interrupt. */
+
+void lapic_bsp_init (uint32_t paddr);
+void lapic_ap_init (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+void lapic_timer_start (void);
+void lapic_timer_stop (void);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+void lapic_send_init (uint8_t apic_id);
+void lapic_send_startup (uint8_t apic_id, uint32_t paddr);
+
+#endif /* devices/lapic.h */
@@ -4,7 +4,15 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/fpu.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/rcu.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -124,6 +132,16 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  thread_print_schedstat ();
+  rcu_print_stats ();
+  palloc_print_stats ();
+  malloc_print_stats ();
+  fpu_print_stats ();
+  slab_print_stats ();
+  intr_print_stats ();
+#ifdef LOCKSTAT
+  lock_print_stats ();
+#endif
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -132,5 +150,6 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+  profile_print_stats ();
 }
 
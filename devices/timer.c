@@ -1,13 +1,18 @@
 #include "devices/timer.h"
 #include <debug.h>
+#include <heap.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/clock.h"
+#include "devices/lapic.h"
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
+#include "threads/seqcount.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
-#include <list.h>
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -18,28 +23,141 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* Number of timer ticks since OS booted.  Changes to TICKS and
+   to ONESHOT_ACTIVE, below, are made in write sections of
+   TICKS_SEQ, so that timer_ticks() can read them with interrupts
+   on. */
 static int64_t ticks;
-
-/* A list of sleeping threads */
-static struct list sleeping_threads;
+static struct seqcount ticks_seq;
+
+/* Hierarchical timer wheel holding the pending timer events.
+
+   Level 0 has one slot per tick for the next WHEEL_SLOTS ticks.
+   Each slot of level L > 0 covers WHEEL_SLOTS**L ticks.  An event
+   goes into the lowest level whose range reaches its expiry, so
+   arming and cancelling take constant time.  Whenever level 0
+   wraps around, the next slot of level 1 is "cascaded", that is,
+   its events are redistributed into level 0, and likewise for
+   the higher levels.  Each event is cascaded at most once per
+   level, so expiry costs amortized constant time per tick.
+
+   Events further in the future than the whole wheel reaches are
+   parked in the last slot of the top level and re-examined every
+   time it is cascaded.
+
+   See [Varghese] "Hashed and Hierarchical Timing Wheels" for
+   the general technique. */
+#define WHEEL_BITS 6                            /* Bits per level. */
+#define WHEEL_SLOTS (1 << WHEEL_BITS)           /* Slots per level. */
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4                          /* Number of levels. */
+#define WHEEL_SPAN ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+/* Next tick whose level 0 slot has not been run yet.  Always at
+   most ticks + 1. */
+static int64_t wheel_ticks;
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* One-shot timer interrupts.
+
+   Channel 0 of the 8254 normally runs in periodic mode,
+   interrupting on every tick boundary.  It is switched to a
+   one-shot in two cases, and always goes back to periodic mode on
+   a tick boundary afterward:
+
+   - Tickless idle.  When the bootstrap processor goes idle and no
+     timer event is due on the next tick, timer_idle_enter()
+     starts a one-shot that expires on the tick boundary of the
+     earliest event.  The one-shot's interrupt, or the first
+     thread to run after an earlier wakeup, catches up on the
+     ticks that went by, running each one's bookkeeping.  The
+     8254's 16-bit counter limits a one-shot to a few ticks, so a
+     long idle period costs one interrupt per one-shot rather
+     than one per tick.
+
+   - High-resolution sleeps.  A thread sleeping for part of a
+     tick waits on HR_SLEEPERS, by deadline on the monotonic
+     clock (see devices/clock.c).  When the earliest deadline
+     comes before the next tick boundary, a one-shot interrupts
+     there to wake the thread, and another one takes over up to
+     the boundary.
+
+   Idle application processors simply stop their local APIC
+   timers; they are woken with a reschedule IPI when there is
+   work to do. */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define PIT_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Ticks closer than this many PIT cycles to their end are not
+   stopped, so that the tick cannot end while the 8254 is being
+   reprogrammed. */
+#define PIT_MARGIN (PIT_TICK / 16)
+
+static bool oneshot_active;     /* Is channel 0 in one-shot mode? */
+static int64_t stopped_ticks;   /* Ticks gone by in earlier one-shots. */
+static uint16_t oneshot_count;  /* PIT cycles the one-shot was started with. */
+static uint16_t oneshot_first;  /* PIT cycles up to its first tick boundary. */
+
+/* A thread in a high-resolution sleep. */
+struct hr_sleeper
+  {
+    struct heap_elem elem;      /* Element in hr_sleepers. */
+    int64_t deadline;           /* clock_ns() at which to wake up. */
+    struct thread *thread;      /* Sleeping thread. */
+  };
+
+/* Threads in high-resolution sleeps, earliest deadline first. */
+static struct heap hr_sleepers;
+
+/* Sleeps shorter than this many nanoseconds busy-wait, because
+   blocking and reprogramming the 8254 would take about as long. */
+#define HR_MIN_NS (20 * 1000)
+
+/* A one-shot may expire up to this many nanoseconds before a
+   deadline it was programmed for, owing to rounding to PIT
+   cycles. */
+#define HR_SLACK_NS (NS_PER_SEC / PIT_HZ + 1)
+
 static intr_handler_func timer_interrupt;
+static void tick_advance (void);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void wheel_insert (struct timer_event *);
+static void wheel_detach (struct list *slot, struct list *events);
+static void wheel_cascade (int level);
+static void wheel_run (void);
+static int64_t wheel_next_expiry (int64_t limit);
+static void start_oneshot (uint16_t count, uint16_t first);
+static uint32_t oneshot_elapsed (bool *expired);
+static unsigned oneshot_boundaries (uint32_t elapsed, uint16_t *to_next);
+static void oneshot_restart (void);
+static void channel0_program (uint16_t to_next, bool at_boundary);
+static uint32_t hr_next_deadline (uint32_t limit);
+static void hr_sleep (int64_t deadline);
+static void hr_wake (void);
+static bool hr_less (const struct heap_elem *, const struct heap_elem *,
+                     void *aux);
+static timer_func wake_thread;
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void)
 {
-  list_init (&sleeping_threads);
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SLOTS; slot++)
+      list_init (&wheel[level][slot]);
+  heap_init (&hr_sleepers, hr_less, NULL);
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -75,12 +193,93 @@ timer_calibrate (void)
 int64_t
 timer_ticks (void)
 {
-  enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
+  enum intr_level old_level;
+  unsigned seq;
+  bool oneshot;
+  int64_t t;
+
+  do
+    {
+      seq = seqcount_read_begin (&ticks_seq);
+      t = ticks;
+      oneshot = oneshot_active;
+    }
+  while (seqcount_read_retry (&ticks_seq, seq));
+  if (!oneshot)
+    return t;
+
+  /* The ticks that go by during a one-shot are only counted when
+     it ends, so we have to look at the 8254, with interrupts off.
+     Only a one-shot that spans a tick boundary needs to. */
+  old_level = intr_disable ();
+  t = ticks;
+  if (oneshot_active)
+    {
+      t += stopped_ticks;
+      if (oneshot_count >= oneshot_first)
+        t += oneshot_boundaries (oneshot_elapsed (NULL), NULL);
+    }
   intr_set_level (old_level);
   return t;
 }
 
+/* Called by an idle thread, with interrupts off, just before it
+   waits for an interrupt.  In tickless mode, stops the periodic
+   timer interrupt on this CPU if nothing needs it. */
+void
+timer_idle_enter (void)
+{
+  struct cpu *cpu = cpu_current ();
+  unsigned boundaries, max_boundaries;
+  uint16_t remaining;
+  uint32_t count;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless)
+    return;
+  if (cpu->id != 0)
+    {
+      lapic_timer_stop ();
+      return;
+    }
+  if (oneshot_active)
+    return;
+
+  /* Find out how many tick boundaries we may sleep through, up to
+     as many as fit in the 8254's counter. */
+  remaining = pit_read_count (0, NULL);
+  if (remaining < PIT_MARGIN || remaining > PIT_TICK)
+    return;
+  max_boundaries = 1 + (UINT16_MAX - remaining) / PIT_TICK;
+  boundaries = wheel_next_expiry (max_boundaries) - ticks;
+  if (boundaries <= 1)
+    return;
+
+  /* Wake up early for a high-resolution sleeper, if need be. */
+  count = remaining + (uint32_t) (boundaries - 1) * PIT_TICK;
+  count = hr_next_deadline (count);
+
+  stopped_ticks = 0;
+  start_oneshot (count, remaining);
+}
+
+/* Called when an idle thread is about to switch to another
+   thread, with interrupts off.  Restarts the periodic timer
+   interrupt on this CPU if timer_idle_enter() stopped it. */
+void
+timer_idle_exit (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless)
+    return;
+  if (cpu_current ()->id != 0)
+    lapic_timer_start ();
+  else if (oneshot_active)
+    oneshot_restart ();
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 int64_t
@@ -89,29 +288,22 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
-/* Compares the wakeup time of two threads. Used to create an ordered
-   list of the threads based on time. */
-bool
-wakeup_time_comparator (struct list_elem *first, struct list_elem *second, void *aux)
-{
-  struct thread *first_thread = list_entry (first, struct thread, elem);
-  struct thread *second_thread = list_entry (second, struct thread, elem);
-  return first_thread->wakeup_time < second_thread->wakeup_time;
-}
-
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
 timer_sleep (int64_t ticks)
 {
   int64_t start = timer_ticks ();
-	enum intr_level old_level;
-  thread_current ()->wakeup_time = start + ticks;
+  struct timer_event wakeup;
+  enum intr_level old_level;
+
   ASSERT (intr_get_level () == INTR_ON);
-  /* Block the thread and add it to the list of sleeping threads. */
+
+  /* Block the thread until a timer event wakes it up. */
+  timer_event_init (&wakeup, wake_thread, thread_current ());
   old_level = intr_disable ();
-  list_insert_ordered(&sleeping_threads, &thread_current ()->elem, wakeup_time_comparator, NULL);
-  thread_block();
+  timer_event_arm (&wakeup, start + ticks);
+  thread_block ();
   intr_set_level (old_level);
 }
 
@@ -184,28 +376,445 @@ timer_print_stats (void)
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
+
+/* Initializes EVENT to call FUNC, passing AUX, when it fires.
+   The event is not armed. */
+void
+timer_event_init (struct timer_event *event, timer_func *func, void *aux)
+{
+  ASSERT (event != NULL);
+  ASSERT (func != NULL);
+
+  event->expires = 0;
+  event->func = func;
+  event->aux = aux;
+  event->pending = false;
+}
+
+/* Arms EVENT to fire once timer_ticks() reaches EXPIRES.  If
+   EXPIRES has already passed, EVENT fires at the next tick.  If
+   EVENT is already armed, it is rearmed. */
+void
+timer_event_arm (struct timer_event *event, int64_t expires)
+{
+  enum intr_level old_level;
+
+  ASSERT (event != NULL);
+
+  old_level = intr_disable ();
+  if (event->pending)
+    list_remove (&event->elem);
+  event->expires = expires;
+  event->pending = true;
+  wheel_insert (event);
+
+  /* Don't sleep through the new event. */
+  if (oneshot_active
+      && expires < (ticks + stopped_ticks
+                    + oneshot_boundaries (oneshot_count, NULL)))
+    oneshot_restart ();
+  intr_set_level (old_level);
+}
+
+/* Disarms EVENT.  Returns true if it was armed, false if it had
+   already fired or was never armed. */
+bool
+timer_event_cancel (struct timer_event *event)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (event != NULL);
+
+  old_level = intr_disable ();
+  was_pending = event->pending;
+  if (was_pending)
+    {
+      list_remove (&event->elem);
+      event->pending = false;
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Returns true if EVENT is armed and has not fired yet. */
+bool
+timer_event_pending (const struct timer_event *event)
+{
+  return event->pending;
+}
 
-/* Timer interrupt handler. */
+/* Counts a timer tick. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+tick_advance (void)
 {
+  seqcount_write_begin (&ticks_seq);
   ticks++;
-  /* Check if any threads should wake up and if so unblock them
-     and remove them from the sleeping_threads list */
-  while (!list_empty (&sleeping_threads))
+  seqcount_write_end (&ticks_seq);
+}
+
+/* Timer interrupt handler. */
+static void
+timer_interrupt (struct intr_frame *args)
+{
+  if (oneshot_active)
     {
-      struct thread *waking_up_thread = list_entry (list_front (&sleeping_threads), struct thread, elem);
-      if (waking_up_thread->wakeup_time <= ticks)
+      /* Account for the tick boundaries the one-shot went
+         through.  All but the last one were idle; the last one is
+         a tick like any other.  A one-shot that has not expired
+         means that a periodic interrupt was still pending when it
+         started, for one more tick. */
+      bool expired, on_boundary;
+      uint16_t to_next;
+      int64_t passed;
+
+      passed = stopped_ticks + oneshot_boundaries (oneshot_elapsed (&expired),
+                                                   &to_next);
+      on_boundary = (expired && oneshot_count >= oneshot_first
+                     && (oneshot_count - oneshot_first) % PIT_TICK == 0);
+      if (!expired)
+        passed++;
+      stopped_ticks = 0;
+      for (; passed > 1; passed--)
+        {
+          tick_advance ();
+          thread_tick_idle ();
+        }
+      if (passed > 0)
         {
-          list_pop_front(&sleeping_threads);
-          thread_unblock(waking_up_thread);
+          tick_advance ();
+          wheel_run ();
+          profile_sample (args);
+          thread_tick ();
         }
+      hr_wake ();
+      channel0_program (to_next, on_boundary);
+    }
+  else
+    {
+      tick_advance ();
+      wheel_run ();
+      profile_sample (args);
+      thread_tick ();
+      if (!heap_empty (&hr_sleepers))
+        channel0_program (pit_read_count (0, NULL), true);
+    }
+}
+
+/* Puts channel 0 of the 8254 in one-shot mode, to interrupt
+   COUNT PIT cycles from now, given that the next tick boundary is
+   FIRST PIT cycles away. */
+static void
+start_oneshot (uint16_t count, uint16_t first)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (count >= 1 && first >= 1);
+
+  oneshot_count = count;
+  oneshot_first = first;
+  seqcount_write_begin (&ticks_seq);
+  oneshot_active = true;
+  seqcount_write_end (&ticks_seq);
+  pit_configure_oneshot (0, count);
+}
+
+/* Returns the number of PIT cycles since the running one-shot
+   started.  If EXPIRED is nonnull, stores into *EXPIRED whether
+   the one-shot has expired. */
+static uint32_t
+oneshot_elapsed (bool *expired)
+{
+  uint16_t count;
+  bool output;
+
+  ASSERT (oneshot_active);
+
+  /* Once a one-shot expires, the counter keeps counting down,
+     wrapping around from 0 to 65535. */
+  count = pit_read_count (0, &output);
+  if (expired != NULL)
+    *expired = output;
+  if (output)
+    return oneshot_count + (uint16_t) -count;
+  else
+    return count <= oneshot_count ? oneshot_count - count : 0;
+}
+
+/* Returns the number of tick boundaries within the first ELAPSED
+   PIT cycles of the running one-shot.  If TO_NEXT is nonnull,
+   stores into *TO_NEXT the number of PIT cycles from there to the
+   next tick boundary. */
+static unsigned
+oneshot_boundaries (uint32_t elapsed, uint16_t *to_next)
+{
+  unsigned boundaries;
+  uint16_t cycles;
+
+  if (elapsed < oneshot_first)
+    {
+      boundaries = 0;
+      cycles = oneshot_first - elapsed;
+    }
+  else
+    {
+      boundaries = 1 + (elapsed - oneshot_first) / PIT_TICK;
+      cycles = PIT_TICK - (elapsed - oneshot_first) % PIT_TICK;
+    }
+
+  if (to_next != NULL)
+    *to_next = cycles;
+  return boundaries;
+}
+
+/* Cuts the running one-shot short, to expire at the next tick
+   boundary, or earlier for a high-resolution sleeper.  If it has
+   already expired, its interrupt is pending and reprograms the
+   8254 itself. */
+static void
+oneshot_restart (void)
+{
+  bool expired;
+  uint16_t to_next;
+  unsigned boundaries;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (oneshot_active);
+
+  boundaries = oneshot_boundaries (oneshot_elapsed (&expired), &to_next);
+  if (!expired)
+    {
+      stopped_ticks += boundaries;
+      channel0_program (to_next, false);
+    }
+}
+
+/* Programs channel 0 of the 8254 for the time up to the next
+   tick boundary, which is TO_NEXT PIT cycles away.  If a
+   high-resolution sleeper is due before then, starts a one-shot
+   for its deadline.  Otherwise, if AT_BOUNDARY, meaning that a
+   tick boundary just went by, puts channel 0 in periodic mode,
+   or else starts a one-shot that expires on the next boundary. */
+static void
+channel0_program (uint16_t to_next, bool at_boundary)
+{
+  uint32_t count;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (to_next == 0)
+    to_next = 1;
+  count = hr_next_deadline (to_next);
+  if (count < to_next || !at_boundary)
+    start_oneshot (count, to_next);
+  else if (oneshot_active)
+    {
+      seqcount_write_begin (&ticks_seq);
+      oneshot_active = false;
+      seqcount_write_end (&ticks_seq);
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+}
+
+/* Returns the number of PIT cycles, at least 1, until the
+   deadline of the first high-resolution sleeper, or LIMIT if
+   there is none before then. */
+static uint32_t
+hr_next_deadline (uint32_t limit)
+{
+  struct hr_sleeper *s;
+  int64_t ns;
+
+  if (heap_empty (&hr_sleepers))
+    return limit;
+  s = heap_entry (heap_front (&hr_sleepers), struct hr_sleeper, elem);
+  ns = s->deadline - clock_ns ();
+  if (ns <= 0)
+    return 1;
+  if (ns >= (int64_t) limit * NS_PER_SEC / PIT_HZ)
+    return limit;
+  return DIV_ROUND_UP (ns * PIT_HZ, NS_PER_SEC);
+}
+
+/* Blocks the running thread until clock_ns() reaches DEADLINE,
+   using a one-shot timer interrupt to wake it up in between tick
+   boundaries. */
+static void
+hr_sleep (int64_t deadline)
+{
+  struct hr_sleeper sleeper;
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  sleeper.deadline = deadline;
+  sleeper.thread = thread_current ();
+
+  old_level = intr_disable ();
+  heap_insert (&hr_sleepers, &sleeper.elem);
+  if (heap_front (&hr_sleepers) == &sleeper.elem)
+    {
+      /* Interrupt no later than the new deadline. */
+      if (oneshot_active)
+        oneshot_restart ();
       else
+        channel0_program (pit_read_count (0, NULL), true);
+    }
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Wakes up the high-resolution sleepers whose deadlines have
+   come. */
+static void
+hr_wake (void)
+{
+  int64_t now = clock_ns () + HR_SLACK_NS;
+
+  ASSERT (intr_context ());
+
+  while (!heap_empty (&hr_sleepers))
+    {
+      struct hr_sleeper *s = heap_entry (heap_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      struct thread *t = s->thread;
+
+      if (s->deadline > now)
+        break;
+      heap_pop (&hr_sleepers);
+      thread_unblock (t);
+
+      /* A thread that wakes up between ticks would otherwise wait
+         for the running one's time slice to end. */
+      if (t->priority > thread_current ()->priority)
+        intr_yield_on_return ();
+    }
+}
+
+/* Returns true if high-resolution sleeper A_ has an earlier
+   deadline than B_, false otherwise. */
+static bool
+hr_less (const struct heap_elem *a_, const struct heap_elem *b_,
+         void *aux UNUSED)
+{
+  const struct hr_sleeper *a = heap_entry (a_, struct hr_sleeper, elem);
+  const struct hr_sleeper *b = heap_entry (b_, struct hr_sleeper, elem);
+
+  return a->deadline < b->deadline;
+}
+
+/* Timer event function for timer_sleep().  Wakes up the thread
+   T_. */
+static void
+wake_thread (void *t_)
+{
+  struct thread *t = t_;
+  thread_unblock (t);
+}
+
+/* Puts EVENT into the timer wheel slot for its expiry. */
+static void
+wheel_insert (struct timer_event *event)
+{
+  int64_t expires = event->expires;
+  int64_t delta;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (expires < wheel_ticks)
+    expires = wheel_ticks;
+  else if (expires - wheel_ticks >= WHEEL_SPAN)
+    expires = wheel_ticks + WHEEL_SPAN - 1;
+  delta = expires - wheel_ticks;
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                & WHEEL_MASK],
+                  &event->elem);
+}
+
+/* Moves all the events in SLOT to EVENTS, which is initialized
+   first, leaving SLOT empty.  Takes constant time. */
+static void
+wheel_detach (struct list *slot, struct list *events)
+{
+  list_init (events);
+  if (!list_empty (slot))
+    list_splice (list_end (events), list_begin (slot), list_end (slot));
+}
+
+/* Redistributes the events in the current slot of LEVEL into
+   the levels below it. */
+static void
+wheel_cascade (int level)
+{
+  struct list *slot = &wheel[level][(wheel_ticks >> (WHEEL_BITS * level))
+                                    & WHEEL_MASK];
+  struct list events;
+
+  /* Detach the slot first: an event parked beyond the end of the
+     wheel may go right back into it. */
+  wheel_detach (slot, &events);
+  while (!list_empty (&events))
+    wheel_insert (list_entry (list_pop_front (&events),
+                              struct timer_event, elem));
+}
+
+/* Returns the first tick, looking no more than LIMIT ticks past
+   the next one the wheel will run, at which the wheel may have an
+   event to fire.  That is a tick with a non-empty level 0 slot or
+   one at which the higher levels cascade. */
+static int64_t
+wheel_next_expiry (int64_t limit)
+{
+  int64_t t;
+
+  for (t = wheel_ticks; t < wheel_ticks + limit; t++)
+    if ((t & WHEEL_MASK) == 0 || !list_empty (&wheel[0][t & WHEEL_MASK]))
+      break;
+  return t;
+}
+
+/* Fires every timer event that is due, catching up on all the
+   ticks since the wheel last ran. */
+static void
+wheel_run (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (wheel_ticks <= ticks)
+    {
+      struct list *slot;
+      struct list events;
+      int level;
+
+      /* When a level wraps around, pull down the next slot of the
+         level above it. */
+      for (level = 1; level < WHEEL_LEVELS; level++)
         {
-          break;
+          if ((wheel_ticks >> (WHEEL_BITS * level)) << (WHEEL_BITS * level)
+              != wheel_ticks)
+            break;
+          wheel_cascade (level);
+        }
+
+      /* Fire the events in the current level 0 slot.  Detach
+         them first, because an event's function may arm events
+         that land in the same slot one lap later. */
+      slot = &wheel[0][wheel_ticks & WHEEL_MASK];
+      wheel_ticks++;
+      wheel_detach (slot, &events);
+      while (!list_empty (&events))
+        {
+          struct timer_event *event
+            = list_entry (list_pop_front (&events), struct timer_event, elem);
+
+          event->pending = false;
+          event->func (event->aux);
         }
     }
-  thread_tick ();
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -252,27 +861,55 @@ real_time_sleep (int64_t num, int32_t denom)
      1 s / TIMER_FREQ ticks
   */
   int64_t ticks = num * TIMER_FREQ / denom;
+  int64_t deadline;
 
   ASSERT (intr_get_level () == INTR_ON);
-  if (ticks > 0)
+  ASSERT (NS_PER_SEC % denom == 0);
+  if (!clock_is_precise ())
     {
-      /* We're waiting for at least one full timer tick.  Use
-         timer_sleep() because it will yield the CPU to other
-         processes. */
-      timer_sleep (ticks);
+      if (ticks > 0)
+        {
+          /* We're waiting for at least one full timer tick.  Use
+             timer_sleep() because it will yield the CPU to other
+             processes. */
+          timer_sleep (ticks);
+        }
+      else
+        {
+          /* Otherwise, use a busy-wait loop for more accurate
+             sub-tick timing. */
+          real_time_delay (num, denom);
+        }
+      return;
     }
+
+  /* Sleep through all but the last tick or so on the timer
+     wheel, which cannot overshoot the deadline, then block until
+     the exact deadline with a one-shot timer interrupt.  Very
+     short sleeps are not worth blocking for. */
+  deadline = clock_ns () + num * (NS_PER_SEC / denom);
+  if (ticks > 1)
+    timer_sleep (ticks - 1);
+  if (deadline - clock_ns () >= HR_MIN_NS)
+    hr_sleep (deadline);
   else
-    {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom);
-    }
+    while (clock_ns () < deadline)
+      barrier ();
 }
 
 /* Busy-wait for approximately NUM/DENOM seconds. */
 static void
 real_time_delay (int64_t num, int32_t denom)
 {
+  if (clock_is_precise ())
+    {
+      /* Spin on the time-stamp counter. */
+      int64_t deadline = clock_ns () + num * (NS_PER_SEC / denom);
+      while (clock_ns () < deadline)
+        barrier ();
+      return;
+    }
+
   /* Scale the numerator and denominator down by 1000 to avoid
      the possibility of overflow. */
   ASSERT (denom % 1000 == 0);
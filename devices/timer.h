@@ -1,14 +1,22 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If true, stop the periodic timer interrupt while idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
+void timer_idle_enter (void);
+void timer_idle_exit (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
@@ -26,4 +34,27 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Callback timers.
+
+   A timer event calls FUNC, passing AUX, from the timer
+   interrupt handler once timer_ticks() reaches EXPIRES.  FUNC
+   runs in an external interrupt context, so it must not sleep.
+   The struct timer_event is owned by the caller and must stay
+   valid until the event fires or is cancelled. */
+typedef void timer_func (void *aux);
+
+struct timer_event
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t expires;            /* Tick at which to call FUNC. */
+    timer_func *func;           /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Armed and not yet fired? */
+  };
+
+void timer_event_init (struct timer_event *, timer_func *, void *aux);
+void timer_event_arm (struct timer_event *, int64_t expires);
+bool timer_event_cancel (struct timer_event *);
+bool timer_event_pending (const struct timer_event *);
+
 #endif /* devices/timer.h */
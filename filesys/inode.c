@@ -6,6 +6,9 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/rcu.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -33,9 +36,10 @@ struct inode
   {
     struct list_elem elem;              /* Element in inode list. */
     block_sector_t sector;              /* Sector number of disk location. */
-    int open_cnt;                       /* Number of openers. */
+    int open_cnt;                       /* Number of openers, atomic. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rcu_head rcu;                /* Frees the inode once unused. */
     struct inode_disk data;             /* Inode content. */
   };
 
@@ -53,15 +57,29 @@ byte_to_sector (const struct inode *inode, off_t pos)
     return -1;
 }
 
+static void inode_free (struct rcu_head *);
+
 /* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
+   returns the same `struct inode'.  Searched under RCU; closed
+   inodes are freed only after a grace period.
+
+   An inode stays on the list for a moment after its open count
+   drops to 0, until inode_close() takes it off, so a search takes
+   a reference only with get_ref(), which fails on such an inode.
+   Insertions and removals are serialized by OPEN_INODES_LOCK. */
 static struct list open_inodes;
+static struct lock open_inodes_lock;
+
+/* In-memory inodes. */
+static struct slab_cache inode_cache;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  lock_init (&open_inodes_lock);
+  slab_cache_init (&inode_cache, "inode", sizeof (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -105,39 +123,100 @@ inode_create (block_sector_t sector, off_t length)
   return success;
 }
 
-/* Reads an inode from SECTOR
-   and returns a `struct inode' that contains it.
-   Returns a null pointer if memory allocation fails. */
-struct inode *
-inode_open (block_sector_t sector)
+/* Increments *CNT and returns true, unless *CNT is 0, in which
+   case returns false without changing it.  Atomic with respect to
+   other CPUs. */
+static bool
+get_ref (int *cnt)
+{
+  int old = *(volatile int *) cnt;
+
+  while (old > 0)
+    {
+      int prev;
+
+      asm volatile ("lock cmpxchgl %2, %1"
+                    : "=a" (prev), "+m" (*cnt)
+                    : "r" (old + 1), "0" (old)
+                    : "memory", "cc");
+      if (prev == old)
+        return true;
+      old = prev;
+    }
+  return false;
+}
+
+/* Decrements *CNT and returns its new value.  Atomic with respect
+   to other CPUs. */
+static int
+put_ref (int *cnt)
+{
+  int old = -1;
+
+  asm volatile ("lock xaddl %0, %1"
+                : "+r" (old), "+m" (*cnt) : : "memory", "cc");
+  return old - 1;
+}
+
+/* Returns the open inode for SECTOR, with a new reference taken
+   on it, or a null pointer if there is none. */
+static struct inode *
+find_open_inode (block_sector_t sector)
 {
   struct list_elem *e;
-  struct inode *inode;
 
-  /* Check whether this inode is already open. */
+  rcu_read_lock ();
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+       e = list_next (e))
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector && get_ref (&inode->open_cnt))
         {
-          inode_reopen (inode);
-          return inode; 
+          rcu_read_unlock ();
+          return inode;
         }
     }
+  rcu_read_unlock ();
+  return NULL;
+}
+
+/* Reads an inode from SECTOR
+   and returns a `struct inode' that contains it.
+   Returns a null pointer if memory allocation fails. */
+struct inode *
+inode_open (block_sector_t sector)
+{
+  struct inode *inode, *open;
+
+  /* Check whether this inode is already open. */
+  inode = find_open_inode (sector);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = slab_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
   block_read (fs_device, inode->sector, &inode->data);
+
+  /* Publish, unless another thread opened the same inode in the
+     meantime. */
+  lock_acquire (&open_inodes_lock);
+  open = find_open_inode (sector);
+  if (open == NULL)
+    rcu_list_push_front (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+  if (open != NULL)
+    {
+      slab_free (&inode_cache, inode);
+      return open;
+    }
   return inode;
 }
 
@@ -146,7 +225,7 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    asm volatile ("lock incl %0" : "+m" (inode->open_cnt) : : "memory", "cc");
   return inode;
 }
 
@@ -168,10 +247,13 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (put_ref (&inode->open_cnt) == 0)
     {
-      /* Remove from inode list and release lock. */
+      /* Remove from inode list.  No new reference can be taken
+         now that the count is 0. */
+      lock_acquire (&open_inodes_lock);
       list_remove (&inode->elem);
+      lock_release (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
@@ -181,10 +263,17 @@ inode_close (struct inode *inode)
                             bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      call_rcu (&inode->rcu, inode_free);
     }
 }
 
+/* Frees an inode that inode_close() removed from open_inodes. */
+static void
+inode_free (struct rcu_head *head)
+{
+  slab_free (&inode_cache, rcu_entry (head, struct inode, rcu));
+}
+
 /* Marks INODE to be deleted when it is closed by the last caller who
    has it open. */
 void
@@ -23,11 +23,30 @@ typedef unsigned long elem_type;
 
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   Operations on ranges of bits work a whole element at a time,
+   finding bits with bsf and counting them with a population
+   count, so scanning for a group of bits takes time proportional
+   to the number of elements, not to the number of bits times the
+   size of the group.
+
+   A bitmap may also have a summary, added with
+   bitmap_add_summary(), with one bit per element of BITS that is
+   set if every bit in that element is set.  Scans for unset bits
+   use it to skip over full regions of the bitmap a word of
+   elements at a time.  The summary is kept exact only if changes
+   to the bitmap are not made concurrently, as is already the
+   case for every caller of bitmap_scan_and_flip().
+
+   Finally, a bitmap has a cursor for next-fit allocation with
+   bitmap_scan_next() and bitmap_scan_and_flip_next(). */
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    elem_type *full;    /* Summary of full elements, or null. */
+    size_t cursor;      /* Where the next next-fit scan starts. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -68,6 +87,85 @@ last_mask (const struct bitmap *b)
   int last_bits = b->bit_cnt % ELEM_BITS;
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns a bit mask in which the bits actually used in element
+   IDX of B's bits are set to 1 and the rest are set to 0. */
+static inline elem_type
+elem_mask (const struct bitmap *b, size_t idx)
+{
+  return idx == elem_cnt (b->bit_cnt) - 1 ? last_mask (b) : (elem_type) -1;
+}
+
+/* Returns a bit mask in which bits FIRST through LAST, inclusive,
+   of an element are set to 1 and the rest are set to 0.  FIRST
+   and LAST are taken modulo ELEM_BITS. */
+static inline elem_type
+range_mask (size_t first, size_t last)
+{
+  return ((elem_type) -1 << (first % ELEM_BITS))
+         & ((elem_type) -1 >> (ELEM_BITS - 1 - last % ELEM_BITS));
+}
+
+/* Returns a bit mask of the bits of element IDX that are
+   between bits START and LAST, inclusive, of a bitmap. */
+static inline elem_type
+clip_mask (size_t idx, size_t start, size_t last)
+{
+  return range_mask (idx == elem_idx (start) ? start : 0,
+                     idx == elem_idx (last) ? last : ELEM_BITS - 1);
+}
+
+/* Returns the index of the lowest set bit in X, which must not
+   be 0. */
+static inline int
+first_set (elem_type x)
+{
+  return __builtin_ctzl (x);
+}
+
+/* Returns the number of set bits in X. */
+static inline int
+pop_count (elem_type x)
+{
+  /* Sum adjacent bits, then pairs, then nibbles, then bytes.
+     GCC's __builtin_popcountl() would call into libgcc, which the
+     kernel does not link with. */
+  x = x - ((x >> 1) & (elem_type) 0x55555555);
+  x = (x & (elem_type) 0x33333333) + ((x >> 2) & (elem_type) 0x33333333);
+  x = (x + (x >> 4)) & (elem_type) 0x0f0f0f0f;
+  return (x * (elem_type) 0x01010101) >> (ELEM_BITS - 8);
+}
+
+/* Atomically ORs MASK into *E. */
+static inline void
+elem_or (elem_type *e, elem_type mask)
+{
+  asm ("lock orl %1, %0" : "=m" (*e) : "r" (mask) : "cc");
+}
+
+/* Atomically ANDs MASK into *E. */
+static inline void
+elem_and (elem_type *e, elem_type mask)
+{
+  asm ("lock andl %1, %0" : "=m" (*e) : "r" (mask) : "cc");
+}
+
+/* Brings the summary bit for element IDX of B's bits up to date,
+   if B has a summary. */
+static inline void
+update_summary (struct bitmap *b, size_t idx)
+{
+  if (b->full != NULL)
+    {
+      elem_type mask = elem_mask (b, idx);
+      elem_type *s = &b->full[elem_idx (idx)];
+
+      if ((b->bits[idx] & mask) == mask)
+        elem_or (s, bit_mask (idx));
+      else
+        elem_and (s, ~bit_mask (idx));
+    }
+}
 
 /* Creation and destruction. */
 
@@ -82,6 +180,8 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->full = NULL;
+      b->cursor = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -105,6 +205,8 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->full = NULL;
+  b->cursor = 0;
   bitmap_set_all (b, false);
   return b;
 }
@@ -117,6 +219,39 @@ bitmap_buf_size (size_t bit_cnt)
   return sizeof (struct bitmap) + byte_cnt (bit_cnt);
 }
 
+/* Adds a summary of full elements to B, which speeds up scans
+   for unset bits in bitmaps that are mostly set.  Returns true
+   if successful, false if memory allocation failed.  A bitmap
+   created with bitmap_create_in_buf() may have a summary too,
+   but then it must be given back with bitmap_destroy_summary(). */
+bool
+bitmap_add_summary (struct bitmap *b) 
+{
+  size_t i;
+
+  ASSERT (b != NULL);
+  ASSERT (b->full == NULL);
+
+  if (b->bit_cnt == 0)
+    return true;
+  b->full = calloc (elem_cnt (elem_cnt (b->bit_cnt)), sizeof (elem_type));
+  if (b->full == NULL)
+    return false;
+  for (i = 0; i < elem_cnt (b->bit_cnt); i++)
+    update_summary (b, i);
+  return true;
+}
+
+/* Frees B's summary, if it has one. */
+void
+bitmap_destroy_summary (struct bitmap *b) 
+{
+  ASSERT (b != NULL);
+
+  free (b->full);
+  b->full = NULL;
+}
+
 /* Destroys bitmap B, freeing its storage.
    Not for use on bitmaps created by
    bitmap_create_preallocated(). */
@@ -125,6 +260,7 @@ bitmap_destroy (struct bitmap *b)
 {
   if (b != NULL) 
     {
+      free (b->full);
       free (b->bits);
       free (b);
     }
@@ -161,9 +297,11 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
   elem_type mask = bit_mask (bit_idx);
 
   /* This is equivalent to `b->bits[idx] |= mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the OR instruction in [IA32-v2b]. */
-  asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+     is guaranteed to be atomic, even on a multiprocessor thanks
+     to the LOCK prefix.  See the descriptions of the OR and
+     LOCK instructions in [IA32-v2b] and [IA32-v2a]. */
+  asm ("lock orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -174,9 +312,11 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
   elem_type mask = bit_mask (bit_idx);
 
   /* This is equivalent to `b->bits[idx] &= ~mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the AND instruction in [IA32-v2a]. */
-  asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+     is guaranteed to be atomic, even on a multiprocessor thanks
+     to the LOCK prefix.  See the descriptions of the AND and
+     LOCK instructions in [IA32-v2a]. */
+  asm ("lock andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -189,9 +329,11 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
   elem_type mask = bit_mask (bit_idx);
 
   /* This is equivalent to `b->bits[idx] ^= mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the XOR instruction in [IA32-v2b]. */
-  asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+     is guaranteed to be atomic, even on a multiprocessor thanks
+     to the LOCK prefix.  See the descriptions of the XOR and
+     LOCK instructions in [IA32-v2b] and [IA32-v2a]. */
+  asm ("lock xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -214,18 +356,29 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.  Each
+   element of B is changed atomically. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t last, idx;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  if (cnt == 0)
+    return;
+  last = start + cnt - 1;
+  for (idx = elem_idx (start); idx <= elem_idx (last); idx++)
+    {
+      elem_type mask = clip_mask (idx, start, last);
+      if (value)
+        elem_or (&b->bits[idx], mask);
+      else
+        elem_and (&b->bits[idx], ~mask);
+      update_summary (b, idx);
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -233,17 +386,19 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t last, idx, value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
+  if (cnt == 0)
+    return 0;
+  last = start + cnt - 1;
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  for (idx = elem_idx (start); idx <= elem_idx (last); idx++)
+    value_cnt += pop_count (b->bits[idx] & clip_mask (idx, start, last));
+  return value ? value_cnt : cnt - value_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -251,15 +406,22 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t last, idx;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
+  if (cnt == 0)
+    return false;
+  last = start + cnt - 1;
+  for (idx = elem_idx (start); idx <= elem_idx (last); idx++)
+    {
+      elem_type mask = clip_mask (idx, start, last);
+      elem_type bits = value ? b->bits[idx] : ~b->bits[idx];
+      if ((bits & mask) != 0)
+        return true;
+    }
   return false;
 }
 
@@ -289,6 +451,59 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first element of B's bits at or after
+   IDX that the summary does not mark as full, or the number of
+   elements if there is none.  B must have a summary. */
+static size_t
+next_nonfull_elem (const struct bitmap *b, size_t idx)
+{
+  size_t elems = elem_cnt (b->bit_cnt);
+  size_t s;
+
+  for (s = elem_idx (idx); s < elem_cnt (elems); s++)
+    {
+      elem_type nonfull = ~b->full[s];
+      if (s == elem_idx (idx))
+        nonfull &= (elem_type) -1 << (idx % ELEM_BITS);
+      if (nonfull != 0)
+        {
+          idx = s * ELEM_BITS + first_set (nonfull);
+          return idx < elems ? idx : elems;
+        }
+    }
+  return elems;
+}
+
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's size if there is none. */
+static size_t
+find_next (const struct bitmap *b, size_t start, bool value)
+{
+  size_t elems = elem_cnt (b->bit_cnt);
+  size_t idx = elem_idx (start);
+  elem_type bits;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+  bits = (value ? b->bits[idx] : ~b->bits[idx])
+         & ((elem_type) -1 << (start % ELEM_BITS));
+  while (bits == 0)
+    {
+      if (++idx >= elems)
+        return b->bit_cnt;
+      if (!value && b->full != NULL
+          && (~b->bits[idx] & elem_mask (b, idx)) == 0)
+        {
+          idx = next_nonfull_elem (b, idx);
+          if (idx >= elems)
+            return b->bit_cnt;
+        }
+      bits = value ? b->bits[idx] : ~b->bits[idx];
+    }
+  start = idx * ELEM_BITS + first_set (bits);
+  return start < b->bit_cnt ? start : b->bit_cnt;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -299,13 +514,21 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  if (cnt == 0)
+    return start;
+  while (cnt <= b->bit_cnt - start)
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      /* Find the next run of bits set to VALUE and check its
+         length. */
+      size_t run_start = find_next (b, start, value);
+      size_t run_end;
+
+      if (cnt > b->bit_cnt - run_start)
+        break;
+      run_end = find_next (b, run_start, !value);
+      if (run_end - run_start >= cnt)
+        return run_start;
+      start = run_end;
     }
   return BITMAP_ERROR;
 }
@@ -325,6 +548,48 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B that are all set to VALUE, searching
+   from B's cursor to the end of B and then from the beginning,
+   and moves the cursor just past the group.  Successive calls
+   thus hand out groups in a rotating, next-fit fashion.
+   If there is no such group, returns BITMAP_ERROR. */
+size_t
+bitmap_scan_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t idx;
+
+  ASSERT (b != NULL);
+
+  idx = bitmap_scan (b, b->cursor, cnt, value);
+  if (idx == BITMAP_ERROR && b->cursor > 0)
+    idx = bitmap_scan (b, 0, cnt, value);
+  if (idx != BITMAP_ERROR)
+    b->cursor = idx + cnt;
+  return idx;
+}
+
+/* Like bitmap_scan_next(), but also flips the bits in the group
+   that is found to !VALUE, as in bitmap_scan_and_flip(). */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t idx = bitmap_scan_next (b, cnt, value);
+  if (idx != BITMAP_ERROR) 
+    bitmap_set_multiple (b, idx, cnt, !value);
+  return idx;
+}
+
+/* Sets B's next-fit cursor to IDX, which may be B's size. */
+void
+bitmap_set_cursor (struct bitmap *b, size_t idx)
+{
+  ASSERT (b != NULL);
+  ASSERT (idx <= b->bit_cnt);
+
+  b->cursor = idx;
+}
 
 /* File input and output. */
 
@@ -345,8 +610,12 @@ bitmap_read (struct bitmap *b, struct file *file)
   if (b->bit_cnt > 0) 
     {
       off_t size = byte_cnt (b->bit_cnt);
+      size_t i;
+
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      for (i = 0; i < elem_cnt (b->bit_cnt); i++)
+        update_summary (b, i);
     }
   return success;
 }
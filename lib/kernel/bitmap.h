@@ -12,6 +12,8 @@ struct bitmap *bitmap_create (size_t bit_cnt);
 struct bitmap *bitmap_create_in_buf (size_t bit_cnt, void *, size_t byte_cnt);
 size_t bitmap_buf_size (size_t bit_cnt);
 void bitmap_destroy (struct bitmap *);
+bool bitmap_add_summary (struct bitmap *);
+void bitmap_destroy_summary (struct bitmap *);
 
 /* Bitmap size. */
 size_t bitmap_size (const struct bitmap *);
@@ -37,6 +39,11 @@ bool bitmap_all (const struct bitmap *, size_t start, size_t cnt);
 size_t bitmap_scan (const struct bitmap *, size_t start, size_t cnt, bool);
 size_t bitmap_scan_and_flip (struct bitmap *, size_t start, size_t cnt, bool);
 
+/* Next-fit scanning. */
+size_t bitmap_scan_next (struct bitmap *, size_t cnt, bool);
+size_t bitmap_scan_and_flip_next (struct bitmap *, size_t cnt, bool);
+void bitmap_set_cursor (struct bitmap *, size_t idx);
+
 /* File input and output. */
 #ifdef FILESYS
 struct file;
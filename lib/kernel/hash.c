@@ -6,18 +6,24 @@
    See hash.h for basic information. */
 
 #include "hash.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include "../debug.h"
 #include "threads/malloc.h"
 
 #define list_elem_to_hash_elem(LIST_ELEM)                       \
         list_entry(LIST_ELEM, struct hash_elem, list_elem)
 
-static struct list *find_bucket (struct hash *, struct hash_elem *);
+static struct list *find_bucket (struct hash *, unsigned hash);
 static struct hash_elem *find_elem (struct hash *, struct list *,
-                                    struct hash_elem *);
-static void insert_elem (struct hash *, struct list *, struct hash_elem *);
+                                    struct hash_elem *, unsigned hash);
+static void insert_elem (struct hash *, struct list *, struct hash_elem *,
+                         unsigned hash);
 static void remove_elem (struct hash *, struct hash_elem *);
 static void rehash (struct hash *);
+static void migrate (struct hash *, size_t bucket_cnt);
+static void finish_migration (struct hash *);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
@@ -28,6 +34,9 @@ hash_init (struct hash *h,
   h->elem_cnt = 0;
   h->bucket_cnt = 4;
   h->buckets = malloc (sizeof *h->buckets * h->bucket_cnt);
+  h->old_buckets = NULL;
+  h->old_bucket_cnt = 0;
+  h->migrate_idx = 0;
   h->hash = hash;
   h->less = less;
   h->aux = aux;
@@ -55,6 +64,7 @@ hash_clear (struct hash *h, hash_action_func *destructor)
 {
   size_t i;
 
+  finish_migration (h);
   for (i = 0; i < h->bucket_cnt; i++) 
     {
       struct list *bucket = &h->buckets[i];
@@ -88,6 +98,7 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
 {
   if (destructor != NULL)
     hash_clear (h, destructor);
+  free (h->old_buckets);
   free (h->buckets);
 }
 
@@ -98,11 +109,12 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
 struct hash_elem *
 hash_insert (struct hash *h, struct hash_elem *new)
 {
-  struct list *bucket = find_bucket (h, new);
-  struct hash_elem *old = find_elem (h, bucket, new);
+  unsigned hash = h->hash (new, h->aux);
+  struct list *bucket = find_bucket (h, hash);
+  struct hash_elem *old = find_elem (h, bucket, new, hash);
 
   if (old == NULL) 
-    insert_elem (h, bucket, new);
+    insert_elem (h, bucket, new, hash);
 
   rehash (h);
 
@@ -114,12 +126,13 @@ hash_insert (struct hash *h, struct hash_elem *new)
 struct hash_elem *
 hash_replace (struct hash *h, struct hash_elem *new) 
 {
-  struct list *bucket = find_bucket (h, new);
-  struct hash_elem *old = find_elem (h, bucket, new);
+  unsigned hash = h->hash (new, h->aux);
+  struct list *bucket = find_bucket (h, hash);
+  struct hash_elem *old = find_elem (h, bucket, new, hash);
 
   if (old != NULL)
     remove_elem (h, old);
-  insert_elem (h, bucket, new);
+  insert_elem (h, bucket, new, hash);
 
   rehash (h);
 
@@ -131,7 +144,8 @@ hash_replace (struct hash *h, struct hash_elem *new)
 struct hash_elem *
 hash_find (struct hash *h, struct hash_elem *e) 
 {
-  return find_elem (h, find_bucket (h, e), e);
+  unsigned hash = h->hash (e, h->aux);
+  return find_elem (h, find_bucket (h, hash), e, hash);
 }
 
 /* Finds, removes, and returns an element equal to E in hash
@@ -144,7 +158,8 @@ hash_find (struct hash *h, struct hash_elem *e)
 struct hash_elem *
 hash_delete (struct hash *h, struct hash_elem *e)
 {
-  struct hash_elem *found = find_elem (h, find_bucket (h, e), e);
+  unsigned hash = h->hash (e, h->aux);
+  struct hash_elem *found = find_elem (h, find_bucket (h, hash), e, hash);
   if (found != NULL) 
     {
       remove_elem (h, found);
@@ -166,6 +181,7 @@ hash_apply (struct hash *h, hash_action_func *action)
   
   ASSERT (action != NULL);
 
+  finish_migration (h);
   for (i = 0; i < h->bucket_cnt; i++) 
     {
       struct list *bucket = &h->buckets[i];
@@ -195,13 +211,19 @@ hash_apply (struct hash *h, hash_action_func *action)
    Modifying hash table H during iteration, using any of the
    functions hash_clear(), hash_destroy(), hash_insert(),
    hash_replace(), or hash_delete(), invalidates all
-   iterators. */
+   iterators.
+
+   If H is being resized, this function finishes moving its
+   elements to the new buckets first, which takes time
+   proportional to the number of elements, as does iterating
+   over them. */
 void
 hash_first (struct hash_iterator *i, struct hash *h) 
 {
   ASSERT (i != NULL);
   ASSERT (h != NULL);
 
+  finish_migration (h);
   i->hash = h;
   i->bucket = i->hash->buckets;
   i->elem = list_elem_to_hash_elem (list_head (i->bucket));
@@ -257,174 +279,706 @@ hash_empty (struct hash *h)
   return h->elem_cnt == 0;
 }
 
-/* Fowler-Noll-Vo hash constants, for 32-bit word sizes. */
-#define FNV_32_PRIME 16777619u
-#define FNV_32_BASIS 2166136261u
+/* Stores statistics for H into STATS.  A resize in progress is
+   not finished, so the number of probes reflects the buckets
+   that lookups actually search. */
+void
+hash_get_stats (struct hash *h, struct hash_stats *stats)
+{
+  size_t i;
+
+  stats->elem_cnt = h->elem_cnt;
+  stats->slot_cnt = h->bucket_cnt;
+  stats->probe_cnt = 0;
+  stats->max_probes = 0;
+  stats->resizing = h->old_buckets != NULL;
+
+  for (i = 0; i < h->old_bucket_cnt + h->bucket_cnt; i++)
+    {
+      struct list *bucket;
+      struct list_elem *e;
+      size_t probes = 0;
+
+      if (i < h->old_bucket_cnt)
+        {
+          if (h->old_buckets == NULL || i < h->migrate_idx)
+            continue;
+          bucket = &h->old_buckets[i];
+        }
+      else
+        bucket = &h->buckets[i - h->old_bucket_cnt];
+
+      for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e))
+        stats->probe_cnt += ++probes;
+      if (probes > stats->max_probes)
+        stats->max_probes = probes;
+    }
+}
+
+/* Prints STATS, labeled with NAME.  The load factor is the
+   number of elements per bucket or slot, and the probe counts
+   are the number of elements compared, or slots examined, to
+   find an element, on average and at worst. */
+void
+hash_print_stats (const struct hash_stats *stats, const char *name)
+{
+  size_t load = stats->slot_cnt > 0
+                ? stats->elem_cnt * 100 / stats->slot_cnt : 0;
+  size_t avg = stats->elem_cnt > 0
+               ? stats->probe_cnt * 100 / stats->elem_cnt : 0;
+
+  printf ("%s: %zu elements in %zu slots, load %zu.%02zu, "
+          "probes %zu.%02zu average, %zu max%s\n",
+          name, stats->elem_cnt, stats->slot_cnt, load / 100, load % 100,
+          avg / 100, avg % 100, stats->max_probes,
+          stats->resizing ? ", resizing" : "");
+}
+
+/* A word that may be unaligned and may alias any object. */
+typedef uint32_t hash_word __attribute__ ((may_alias, aligned (1)));
+
+/* MurmurHash3 constants. */
+#define MURMUR_C1 0xcc9e2d51u
+#define MURMUR_C2 0x1b873593u
+
+/* Rotates X left by N bits. */
+static inline unsigned
+rotl (unsigned x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+/* Scrambles word K for mixing into a MurmurHash3 hash. */
+static inline unsigned
+murmur_scramble (unsigned k)
+{
+  return rotl (k * MURMUR_C1, 15) * MURMUR_C2;
+}
+
+/* MurmurHash3 finalizer.  Makes every bit of HASH affect every
+   bit of the result, so that the low-order bits used to pick a
+   bucket depend on all of the input. */
+static inline unsigned
+murmur_finish (unsigned hash)
+{
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  return hash;
+}
 
 /* Returns a hash of the SIZE bytes in BUF. */
 unsigned
 hash_bytes (const void *buf_, size_t size)
 {
-  /* Fowler-Noll-Vo 32-bit hash, for bytes. */
-  const unsigned char *buf = buf_;
-  unsigned hash;
+  /* MurmurHash3 32-bit hash, which takes the bytes a word at a
+     time. */
+  const uint8_t *buf = buf_;
+  unsigned hash, k;
 
   ASSERT (buf != NULL);
 
-  hash = FNV_32_BASIS;
-  while (size-- > 0)
-    hash = (hash * FNV_32_PRIME) ^ *buf++;
+  hash = size;
+  for (; size >= sizeof (hash_word); size -= sizeof (hash_word))
+    {
+      hash ^= murmur_scramble (*(const hash_word *) buf);
+      hash = rotl (hash, 13) * 5 + 0xe6546b64u;
+      buf += sizeof (hash_word);
+    }
 
-  return hash;
-} 
+  k = 0;
+  switch (size)
+    {
+    case 3:
+      k |= buf[2] << 16;
+      /* Fall through. */
+    case 2:
+      k |= buf[1] << 8;
+      /* Fall through. */
+    case 1:
+      k |= buf[0];
+      hash ^= murmur_scramble (k);
+    }
+
+  return murmur_finish (hash);
+}
 
 /* Returns a hash of string S. */
 unsigned
-hash_string (const char *s_) 
+hash_string (const char *s)
 {
-  const unsigned char *s = (const unsigned char *) s_;
-  unsigned hash;
-
   ASSERT (s != NULL);
 
-  hash = FNV_32_BASIS;
-  while (*s != '\0')
-    hash = (hash * FNV_32_PRIME) ^ *s++;
-
-  return hash;
+  return hash_bytes (s, strlen (s));
 }
 
 /* Returns a hash of integer I. */
 unsigned
-hash_int (int i) 
+hash_int (int i)
 {
-  return hash_bytes (&i, sizeof i);
+  return murmur_finish (i);
 }
-
-/* Returns the bucket in H that E belongs in. */
+
+/* Returns the bucket in H that an element with the given HASH
+   belongs in.  While H is being resized, that is the bucket in
+   the old array unless that bucket has already been moved. */
 static struct list *
-find_bucket (struct hash *h, struct hash_elem *e) 
+find_bucket (struct hash *h, unsigned hash)
 {
-  size_t bucket_idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
-  return &h->buckets[bucket_idx];
+  if (h->old_buckets != NULL)
+    {
+      size_t old_idx = hash & (h->old_bucket_cnt - 1);
+      if (old_idx >= h->migrate_idx)
+        return &h->old_buckets[old_idx];
+    }
+  return &h->buckets[hash & (h->bucket_cnt - 1)];
 }
 
-/* Searches BUCKET in H for a hash element equal to E.  Returns
-   it if found or a null pointer otherwise. */
+/* Searches BUCKET in H for a hash element equal to E, whose hash
+   value is HASH.  Returns it if found or a null pointer
+   otherwise. */
 static struct hash_elem *
-find_elem (struct hash *h, struct list *bucket, struct hash_elem *e) 
+find_elem (struct hash *h, struct list *bucket, struct hash_elem *e,
+           unsigned hash)
 {
   struct list_elem *i;
 
-  for (i = list_begin (bucket); i != list_end (bucket); i = list_next (i)) 
+  for (i = list_begin (bucket); i != list_end (bucket); i = list_next (i))
     {
       struct hash_elem *hi = list_elem_to_hash_elem (i);
-      if (!h->less (hi, e, h->aux) && !h->less (e, hi, h->aux))
-        return hi; 
+      if (hi->hash == hash
+          && !h->less (hi, e, h->aux) && !h->less (e, hi, h->aux))
+        return hi;
     }
   return NULL;
 }
 
-/* Returns X with its lowest-order bit set to 1 turned off. */
-static inline size_t
-turn_off_least_1bit (size_t x) 
-{
-  return x & (x - 1);
-}
-
-/* Returns true if X is a power of 2, otherwise false. */
-static inline size_t
-is_power_of_2 (size_t x) 
-{
-  return x != 0 && turn_off_least_1bit (x) == 0;
-}
-
 /* Element per bucket ratios. */
 #define MIN_ELEMS_PER_BUCKET  1 /* Elems/bucket < 1: reduce # of buckets. */
 #define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
 #define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
 
-/* Changes the number of buckets in hash table H to match the
-   ideal.  This function can fail because of an out-of-memory
-   condition, but that'll just make hash accesses less efficient;
-   we can still continue. */
+/* Old buckets moved to the new array by each insertion or
+   deletion during a resize.  A resize doubles or halves the
+   number of buckets at least, and the number of elements must
+   then change by at least half before the next one, so a
+   resize always finishes well before another is needed. */
+#define MIGRATE_BUCKETS 4
+
+/* Returns the number of buckets that H should have, a power of 2
+   and at least 4.  Once the number of elements per bucket
+   strays outside MIN_ELEMS_PER_BUCKET...MAX_ELEMS_PER_BUCKET,
+   it is brought back between MIN_ELEMS_PER_BUCKET and
+   BEST_ELEMS_PER_BUCKET. */
+static size_t
+ideal_bucket_cnt (struct hash *h)
+{
+  size_t bucket_cnt = h->bucket_cnt;
+
+  if (h->elem_cnt > bucket_cnt * MAX_ELEMS_PER_BUCKET)
+    while (h->elem_cnt > bucket_cnt * BEST_ELEMS_PER_BUCKET)
+      bucket_cnt *= 2;
+  else
+    while (bucket_cnt > 4 && h->elem_cnt < bucket_cnt * MIN_ELEMS_PER_BUCKET)
+      bucket_cnt /= 2;
+  return bucket_cnt;
+}
+
+/* Moves the elements of H along the resize that is in progress,
+   if any, or starts a resize if the number of buckets strays
+   too far from the ideal.  This function can fail because of an
+   out-of-memory condition, but that'll just make hash accesses
+   less efficient; we can still continue. */
 static void
-rehash (struct hash *h) 
+rehash (struct hash *h)
 {
-  size_t old_bucket_cnt, new_bucket_cnt;
-  struct list *new_buckets, *old_buckets;
+  size_t new_bucket_cnt;
+  struct list *new_buckets;
   size_t i;
 
   ASSERT (h != NULL);
 
-  /* Save old bucket info for later use. */
-  old_buckets = h->buckets;
-  old_bucket_cnt = h->bucket_cnt;
-
-  /* Calculate the number of buckets to use now.
-     We want one bucket for about every BEST_ELEMS_PER_BUCKET.
-     We must have at least four buckets, and the number of
-     buckets must be a power of 2. */
-  new_bucket_cnt = h->elem_cnt / BEST_ELEMS_PER_BUCKET;
-  if (new_bucket_cnt < 4)
-    new_bucket_cnt = 4;
-  while (!is_power_of_2 (new_bucket_cnt))
-    new_bucket_cnt = turn_off_least_1bit (new_bucket_cnt);
+  if (h->old_buckets != NULL)
+    {
+      migrate (h, MIGRATE_BUCKETS);
+      return;
+    }
 
   /* Don't do anything if the bucket count wouldn't change. */
-  if (new_bucket_cnt == old_bucket_cnt)
+  new_bucket_cnt = ideal_bucket_cnt (h);
+  if (new_bucket_cnt == h->bucket_cnt)
     return;
 
   /* Allocate new buckets and initialize them as empty. */
   new_buckets = malloc (sizeof *new_buckets * new_bucket_cnt);
-  if (new_buckets == NULL) 
+  if (new_buckets == NULL)
     {
       /* Allocation failed.  This means that use of the hash table will
          be less efficient.  However, it is still usable, so
          there's no reason for it to be an error. */
       return;
     }
-  for (i = 0; i < new_bucket_cnt; i++) 
+  for (i = 0; i < new_bucket_cnt; i++)
     list_init (&new_buckets[i]);
 
-  /* Install new bucket info. */
+  /* Install new bucket info, keeping the old buckets until all
+     of their elements have been moved. */
+  h->old_buckets = h->buckets;
+  h->old_bucket_cnt = h->bucket_cnt;
+  h->migrate_idx = 0;
   h->buckets = new_buckets;
   h->bucket_cnt = new_bucket_cnt;
 
-  /* Move each old element into the appropriate new bucket. */
-  for (i = 0; i < old_bucket_cnt; i++) 
+  migrate (h, MIGRATE_BUCKETS);
+}
+
+/* Moves the elements of up to BUCKET_CNT old buckets in H into
+   the new buckets, and frees the old buckets once they are all
+   empty. */
+static void
+migrate (struct hash *h, size_t bucket_cnt)
+{
+  for (; bucket_cnt > 0 && h->migrate_idx < h->old_bucket_cnt; bucket_cnt--)
     {
-      struct list *old_bucket;
-      struct list_elem *elem, *next;
+      struct list *old_bucket = &h->old_buckets[h->migrate_idx++];
 
-      old_bucket = &old_buckets[i];
-      for (elem = list_begin (old_bucket);
-           elem != list_end (old_bucket); elem = next) 
+      while (!list_empty (old_bucket))
         {
-          struct list *new_bucket
-            = find_bucket (h, list_elem_to_hash_elem (elem));
-          next = list_next (elem);
-          list_remove (elem);
-          list_push_front (new_bucket, elem);
+          struct list_elem *elem = list_pop_front (old_bucket);
+          unsigned hash = list_elem_to_hash_elem (elem)->hash;
+          list_push_front (&h->buckets[hash & (h->bucket_cnt - 1)], elem);
         }
     }
 
-  free (old_buckets);
+  if (h->migrate_idx >= h->old_bucket_cnt)
+    {
+      free (h->old_buckets);
+      h->old_buckets = NULL;
+      h->old_bucket_cnt = 0;
+      h->migrate_idx = 0;
+    }
+}
+
+/* Finishes any resize of H that is in progress. */
+static void
+finish_migration (struct hash *h)
+{
+  if (h->old_buckets != NULL)
+    migrate (h, SIZE_MAX);
 }
 
-/* Inserts E into BUCKET (in hash table H). */
+/* Inserts E, whose hash value is HASH, into BUCKET (in hash
+   table H). */
 static void
-insert_elem (struct hash *h, struct list *bucket, struct hash_elem *e) 
+insert_elem (struct hash *h, struct list *bucket, struct hash_elem *e,
+             unsigned hash)
 {
   h->elem_cnt++;
+  e->hash = hash;
   list_push_front (bucket, &e->list_elem);
 }
 
 /* Removes E from hash table H. */
 static void
-remove_elem (struct hash *h, struct hash_elem *e) 
+remove_elem (struct hash *h, struct hash_elem *e)
 {
   h->elem_cnt--;
   list_remove (&e->list_elem);
 }
 
+/* Open-addressing hash table. */
+
+/* Marks a slot in the old array of a table being resized whose
+   element has been moved or deleted.  Lookups in the old array
+   probe past it, as they would past the element it replaced. */
+static struct hash_elem ohash_tombstone;
+#define TOMBSTONE (&ohash_tombstone)
+
+/* Number of slots in an empty table, and the least to which a
+   table shrinks. */
+#define OHASH_MIN_SLOTS 8
+
+/* Old slots moved to the new array by each insertion or deletion
+   during a resize.  Slots hold one element each, and most of them
+   are empty when a table shrinks, so many more of them are moved
+   at a time than buckets are.  A table that shrinks because it
+   is 1/8 full must be able to finish before it is 1/16 full. */
+#define MIGRATE_SLOTS 32
+
+static struct ohash_slot *ohash_find_slot (struct ohash *, struct hash_elem *,
+                                           unsigned hash);
+static void ohash_insert_slot (struct ohash *, struct hash_elem *,
+                               unsigned hash);
+static void ohash_rehash (struct ohash *);
+static void ohash_migrate (struct ohash *, size_t slot_cnt);
+static void ohash_finish_migration (struct ohash *);
+
+/* Initializes open-addressing hash table H to compute hash
+   values using HASH and compare hash elements using LESS, given
+   auxiliary data AUX. */
+bool
+ohash_init (struct ohash *h,
+            hash_hash_func *hash, hash_less_func *less, void *aux)
+{
+  h->elem_cnt = 0;
+  h->slot_cnt = OHASH_MIN_SLOTS;
+  h->slots = malloc (sizeof *h->slots * h->slot_cnt);
+  h->old_slots = NULL;
+  h->old_slot_cnt = 0;
+  h->migrate_idx = 0;
+  h->hash = hash;
+  h->less = less;
+  h->aux = aux;
+
+  if (h->slots != NULL)
+    {
+      ohash_clear (h, NULL);
+      return true;
+    }
+  else
+    return false;
+}
+
+/* Removes all the elements from H, calling DESTRUCTOR for each
+   of them if it is non-null, as hash_clear() does. */
+void
+ohash_clear (struct ohash *h, hash_action_func *destructor)
+{
+  size_t i;
+
+  ohash_finish_migration (h);
+  for (i = 0; i < h->slot_cnt; i++)
+    {
+      struct hash_elem *e = h->slots[i].elem;
+
+      h->slots[i].elem = NULL;
+      if (e != NULL && destructor != NULL)
+        destructor (e, h->aux);
+    }
+
+  h->elem_cnt = 0;
+}
+
+/* Destroys H, first calling DESTRUCTOR for each element if it is
+   non-null, as hash_destroy() does. */
+void
+ohash_destroy (struct ohash *h, hash_action_func *destructor)
+{
+  if (destructor != NULL)
+    ohash_clear (h, destructor);
+  free (h->old_slots);
+  free (h->slots);
+}
+
+/* Inserts NEW into H and returns a null pointer, if no equal
+   element is already in the table.  If an equal element is
+   already in the table, returns it without inserting NEW. */
+struct hash_elem *
+ohash_insert (struct ohash *h, struct hash_elem *new)
+{
+  unsigned hash = h->hash (new, h->aux);
+  struct ohash_slot *slot = ohash_find_slot (h, new, hash);
+
+  if (slot != NULL)
+    return slot->elem;
+
+  ohash_insert_slot (h, new, hash);
+  ohash_rehash (h);
+  return NULL;
+}
+
+/* Inserts NEW into H, replacing any equal element already in the
+   table, which is returned. */
+struct hash_elem *
+ohash_replace (struct ohash *h, struct hash_elem *new)
+{
+  unsigned hash = h->hash (new, h->aux);
+  struct ohash_slot *slot = ohash_find_slot (h, new, hash);
+  struct hash_elem *old;
+
+  if (slot != NULL)
+    {
+      old = slot->elem;
+      slot->elem = new;
+      return old;
+    }
+
+  ohash_insert_slot (h, new, hash);
+  ohash_rehash (h);
+  return NULL;
+}
+
+/* Finds and returns an element equal to E in H, or a null
+   pointer if no equal element exists in the table. */
+struct hash_elem *
+ohash_find (struct ohash *h, struct hash_elem *e)
+{
+  struct ohash_slot *slot = ohash_find_slot (h, e, h->hash (e, h->aux));
+  return slot != NULL ? slot->elem : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in H.
+   Returns a null pointer if no equal element existed in the
+   table.
+
+   Later elements in the same cluster of slots are shifted back
+   into the one that becomes free, so that lookups never need to
+   probe past deleted elements. */
+struct hash_elem *
+ohash_delete (struct ohash *h, struct hash_elem *e)
+{
+  unsigned hash = h->hash (e, h->aux);
+  struct ohash_slot *slot = ohash_find_slot (h, e, hash);
+  struct hash_elem *found;
+
+  if (slot == NULL)
+    return NULL;
+
+  found = slot->elem;
+  if (slot < h->slots || slot >= h->slots + h->slot_cnt)
+    slot->elem = TOMBSTONE;
+  else
+    {
+      size_t mask = h->slot_cnt - 1;
+      size_t i = slot - h->slots;
+      size_t j = i;
+
+      for (;;)
+        {
+          j = (j + 1) & mask;
+          if (h->slots[j].elem == NULL)
+            break;
+
+          /* Move the element in slot J back into the hole at I,
+             unless its home slot lies after I, where a lookup
+             would no longer reach it. */
+          if (((j - h->slots[j].hash) & mask) >= ((j - i) & mask))
+            {
+              h->slots[i] = h->slots[j];
+              i = j;
+            }
+        }
+      h->slots[i].elem = NULL;
+    }
+  h->elem_cnt--;
+
+  ohash_rehash (h);
+  return found;
+}
+
+/* Calls ACTION for each element in H in arbitrary order, as
+   hash_apply() does. */
+void
+ohash_apply (struct ohash *h, hash_action_func *action)
+{
+  size_t i;
+
+  ASSERT (action != NULL);
+
+  ohash_finish_migration (h);
+  for (i = 0; i < h->slot_cnt; i++)
+    if (h->slots[i].elem != NULL)
+      action (h->slots[i].elem, h->aux);
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h)
+{
+  return h->elem_cnt == 0;
+}
+
+/* Stores statistics for H into STATS, as hash_get_stats()
+   does.  The probes for an element are the slots from its home
+   slot to the one it is in. */
+void
+ohash_get_stats (struct ohash *h, struct hash_stats *stats)
+{
+  size_t i;
+
+  stats->elem_cnt = h->elem_cnt;
+  stats->slot_cnt = h->slot_cnt;
+  stats->probe_cnt = 0;
+  stats->max_probes = 0;
+  stats->resizing = h->old_slots != NULL;
+
+  for (i = 0; i < h->old_slot_cnt + h->slot_cnt; i++)
+    {
+      struct ohash_slot *slot;
+      size_t idx, mask, probes;
+
+      if (i < h->old_slot_cnt)
+        {
+          if (h->old_slots == NULL)
+            continue;
+          idx = i;
+          mask = h->old_slot_cnt - 1;
+          slot = &h->old_slots[idx];
+        }
+      else
+        {
+          idx = i - h->old_slot_cnt;
+          mask = h->slot_cnt - 1;
+          slot = &h->slots[idx];
+        }
+      if (slot->elem == NULL || slot->elem == TOMBSTONE)
+        continue;
+
+      probes = ((idx - slot->hash) & mask) + 1;
+      stats->probe_cnt += probes;
+      if (probes > stats->max_probes)
+        stats->max_probes = probes;
+    }
+}
+
+/* Probes the SLOT_CNT SLOTS for an element equal to E, whose hash
+   value is HASH, and returns its slot, or a null pointer if
+   there is none. */
+static struct ohash_slot *
+probe (struct ohash *h, struct ohash_slot *slots, size_t slot_cnt,
+       struct hash_elem *e, unsigned hash)
+{
+  size_t mask = slot_cnt - 1;
+  size_t idx = hash & mask;
+  size_t n;
+
+  for (n = 0; n < slot_cnt; n++, idx = (idx + 1) & mask)
+    {
+      struct ohash_slot *slot = &slots[idx];
+
+      if (slot->elem == NULL)
+        break;
+      if (slot->hash == hash && slot->elem != TOMBSTONE
+          && !h->less (slot->elem, e, h->aux)
+          && !h->less (e, slot->elem, h->aux))
+        return slot;
+    }
+  return NULL;
+}
+
+/* Returns the slot in H that holds an element equal to E, whose
+   hash value is HASH, or a null pointer if there is none.
+   While H is being resized, the element may be in either
+   array. */
+static struct ohash_slot *
+ohash_find_slot (struct ohash *h, struct hash_elem *e, unsigned hash)
+{
+  if (h->old_slots != NULL)
+    {
+      struct ohash_slot *slot = probe (h, h->old_slots, h->old_slot_cnt,
+                                       e, hash);
+      if (slot != NULL)
+        return slot;
+    }
+  return probe (h, h->slots, h->slot_cnt, e, hash);
+}
+
+/* Puts E, whose hash value is HASH, into the first free slot
+   after its home slot in H's current array.  E must not already
+   be in H. */
+static void
+ohash_insert_slot (struct ohash *h, struct hash_elem *e, unsigned hash)
+{
+  size_t mask = h->slot_cnt - 1;
+  size_t idx = hash & mask;
+
+  if (h->elem_cnt + 1 >= h->slot_cnt)
+    PANIC ("open-addressing hash table full");
+
+  while (h->slots[idx].elem != NULL)
+    idx = (idx + 1) & mask;
+  h->slots[idx].hash = hash;
+  h->slots[idx].elem = e;
+  h->elem_cnt++;
+}
+
+/* Moves the elements of H along the resize that is in progress,
+   if any, or starts a resize if the load factor strays outside
+   1/8...3/4, bringing it back to 1/4...1/2.  Running out of
+   memory just leaves the load factor where it is, until the
+   table fills up. */
+static void
+ohash_rehash (struct ohash *h)
+{
+  size_t new_slot_cnt = h->slot_cnt;
+  struct ohash_slot *new_slots;
+  size_t i;
+
+  if (h->old_slots != NULL)
+    {
+      ohash_migrate (h, MIGRATE_SLOTS);
+      return;
+    }
+
+  if (h->elem_cnt * 4 > new_slot_cnt * 3)
+    while (h->elem_cnt * 2 > new_slot_cnt)
+      new_slot_cnt *= 2;
+  else if (h->elem_cnt * 8 < new_slot_cnt)
+    while (new_slot_cnt > OHASH_MIN_SLOTS && h->elem_cnt * 4 < new_slot_cnt)
+      new_slot_cnt /= 2;
+  if (new_slot_cnt == h->slot_cnt)
+    return;
+
+  new_slots = malloc (sizeof *new_slots * new_slot_cnt);
+  if (new_slots == NULL)
+    return;
+  for (i = 0; i < new_slot_cnt; i++)
+    new_slots[i].elem = NULL;
+
+  h->old_slots = h->slots;
+  h->old_slot_cnt = h->slot_cnt;
+  h->migrate_idx = 0;
+  h->slots = new_slots;
+  h->slot_cnt = new_slot_cnt;
+
+  ohash_migrate (h, MIGRATE_SLOTS);
+}
+
+/* Moves the elements of up to SLOT_CNT old slots in H into the
+   new array, leaving tombstones behind, and frees the old array
+   once every slot in it has been moved. */
+static void
+ohash_migrate (struct ohash *h, size_t slot_cnt)
+{
+  size_t mask = h->slot_cnt - 1;
+
+  for (; slot_cnt > 0 && h->migrate_idx < h->old_slot_cnt; slot_cnt--)
+    {
+      struct ohash_slot *old = &h->old_slots[h->migrate_idx++];
+
+      if (old->elem != NULL && old->elem != TOMBSTONE)
+        {
+          size_t idx = old->hash & mask;
+
+          while (h->slots[idx].elem != NULL)
+            idx = (idx + 1) & mask;
+          h->slots[idx] = *old;
+          old->elem = TOMBSTONE;
+        }
+    }
+
+  if (h->migrate_idx >= h->old_slot_cnt)
+    {
+      free (h->old_slots);
+      h->old_slots = NULL;
+      h->old_slot_cnt = 0;
+      h->migrate_idx = 0;
+    }
+}
+
+/* Finishes any resize of H that is in progress. */
+static void
+ohash_finish_migration (struct ohash *h)
+{
+  if (h->old_slots != NULL)
+    ohash_migrate (h, SIZE_MAX);
+}
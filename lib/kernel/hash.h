@@ -18,7 +18,19 @@
    conversion from a struct hash_elem back to a structure object
    that contains it.  This is the same technique used in the
    linked list implementation.  Refer to lib/kernel/list.h for a
-   detailed explanation. */
+   detailed explanation.
+
+   The table grows and shrinks incrementally.  When the number of
+   buckets needs to change, a new bucket array is allocated and
+   each later insertion or deletion moves a few of the old
+   buckets' elements into it, so that no single operation takes
+   time proportional to the size of the table.  Each element
+   caches its hash value, so moving it does not call the hash
+   function, and searching a bucket compares hash values before
+   calling the comparison function.
+
+   struct ohash below is a variant of the same table that uses
+   open addressing instead of chaining. */
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -29,6 +41,7 @@
 struct hash_elem 
   {
     struct list_elem list_elem;
+    unsigned hash;              /* Cached hash value. */
   };
 
 /* Converts pointer to hash element HASH_ELEM into a pointer to
@@ -61,6 +74,9 @@ struct hash
     size_t elem_cnt;            /* Number of elements in table. */
     size_t bucket_cnt;          /* Number of buckets, a power of 2. */
     struct list *buckets;       /* Array of `bucket_cnt' lists. */
+    struct list *old_buckets;   /* Buckets being resized from, or null. */
+    size_t old_bucket_cnt;      /* Number of old buckets. */
+    size_t migrate_idx;         /* First old bucket not yet moved. */
     hash_hash_func *hash;       /* Hash function. */
     hash_less_func *less;       /* Comparison function. */
     void *aux;                  /* Auxiliary data for `hash' and `less'. */
@@ -95,6 +111,70 @@ struct hash_elem *hash_cur (struct hash_iterator *);
 size_t hash_size (struct hash *);
 bool hash_empty (struct hash *);
 
+/* Hash table statistics. */
+struct hash_stats
+  {
+    size_t elem_cnt;            /* Number of elements. */
+    size_t slot_cnt;            /* Number of buckets or slots. */
+    size_t probe_cnt;           /* Probes to find every element once. */
+    size_t max_probes;          /* Probes to find the worst element. */
+    bool resizing;              /* In the middle of a resize? */
+  };
+
+void hash_get_stats (struct hash *, struct hash_stats *);
+void hash_print_stats (const struct hash_stats *, const char *name);
+
+/* Open-addressing hash table.
+
+   Elements are the same struct hash_elem as above, used with
+   the same kind of hash and comparison functions, but the table
+   is an array of slots, each holding an element's hash value and
+   a pointer to it, searched by linear probing.  A lookup thus
+   touches consecutive slots in the same few cache lines instead
+   of following a chain of pointers through the elements, and
+   the elements' list_elem members go unused.
+
+   The table keeps its load factor between 1/8 and 3/4 and
+   resizes incrementally, like struct hash.  Deletion shifts
+   later elements of the same cluster back rather than leaving
+   tombstones, except in the old array during a resize.  If the
+   table cannot grow for lack of memory, it keeps filling up, and
+   inserting into a full table panics the kernel. */
+
+/* A slot in an open-addressing hash table. */
+struct ohash_slot
+  {
+    unsigned hash;              /* Hash value of ELEM. */
+    struct hash_elem *elem;     /* Element, or null if empty. */
+  };
+
+/* Open-addressing hash table. */
+struct ohash
+  {
+    size_t elem_cnt;            /* Number of elements in table. */
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    struct ohash_slot *slots;   /* Array of `slot_cnt' slots. */
+    struct ohash_slot *old_slots; /* Slots being resized from, or null. */
+    size_t old_slot_cnt;        /* Number of old slots. */
+    size_t migrate_idx;         /* First old slot not yet moved. */
+    hash_hash_func *hash;       /* Hash function. */
+    hash_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `hash' and `less'. */
+  };
+
+bool ohash_init (struct ohash *, hash_hash_func *, hash_less_func *,
+                 void *aux);
+void ohash_clear (struct ohash *, hash_action_func *);
+void ohash_destroy (struct ohash *, hash_action_func *);
+struct hash_elem *ohash_insert (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_replace (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_find (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_delete (struct ohash *, struct hash_elem *);
+void ohash_apply (struct ohash *, hash_action_func *);
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+void ohash_get_stats (struct ohash *, struct hash_stats *);
+
 /* Sample hash functions. */
 unsigned hash_bytes (const void *, size_t);
 unsigned hash_string (const char *);
@@ -0,0 +1,204 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* Pairing heap, after Fredman, Sedgewick, Sleator and Tarjan,
+   "The Pairing Heap: A New Form of Self-Adjusting Heap".  Each
+   element's children form a doubly linked list through `next'
+   and `prev', with the first child's `prev' pointing back to the
+   parent, so that any element can be cut out in O(1) time. */
+
+static struct heap_elem *meld (struct heap *, struct heap_elem *,
+                               struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+static void cut (struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->size = 0;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_insert (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = meld (heap, heap->root, elem);
+  heap->size++;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem)
+{
+  struct heap_elem *children;
+
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+  ASSERT (heap->size > 0);
+
+  children = merge_pairs (heap, elem->child);
+  if (elem == heap->root)
+    heap->root = children;
+  else
+    {
+      cut (elem);
+      heap->root = meld (heap, heap->root, children);
+    }
+  elem->child = NULL;
+  heap->size--;
+}
+
+/* Removes and returns the smallest element of HEAP, or a null
+   pointer if HEAP is empty. */
+struct heap_elem *
+heap_pop (struct heap *heap)
+{
+  struct heap_elem *root = heap->root;
+
+  if (root != NULL)
+    heap_remove (heap, root);
+  return root;
+}
+
+/* Restores the order of HEAP after the key of ELEM, which must
+   be in HEAP, decreased or stayed the same.  Takes O(1) time. */
+void
+heap_promote (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  if (elem != heap->root)
+    {
+      cut (elem);
+      heap->root = meld (heap, heap->root, elem);
+    }
+}
+
+/* Restores the order of HEAP after the key of ELEM, which must
+   be in HEAP, changed in any way. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem)
+{
+  heap_remove (heap, elem);
+  heap_insert (heap, elem);
+}
+
+/* Returns the smallest element of HEAP, or a null pointer if
+   HEAP is empty. */
+struct heap_elem *
+heap_front (const struct heap *heap)
+{
+  ASSERT (heap != NULL);
+  return heap->root;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (const struct heap *heap)
+{
+  ASSERT (heap != NULL);
+  return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap)
+{
+  ASSERT (heap != NULL);
+  return heap->root == NULL;
+}
+
+/* Melds the heaps rooted at A and B, either of which may be
+   null, and returns the root of the result.  A and B must not
+   have siblings or parents. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (heap->less (b, a, heap->aux))
+    {
+      struct heap_elem *tmp = a;
+      a = b;
+      b = tmp;
+    }
+
+  /* Make B the first child of A. */
+  b->next = a->child;
+  if (b->next != NULL)
+    b->next->prev = b;
+  b->prev = a;
+  a->child = b;
+  return a;
+}
+
+/* Melds the list of siblings that starts at FIRST into a single
+   heap and returns its root, or a null pointer if FIRST is null.
+   Melds the siblings in pairs from left to right, then the pairs
+   from right to left, which is what gives removal its O(log n)
+   amortized bound. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* First pass, left to right, stacking the results through
+     `next'. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+      struct heap_elem *pair;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+      pair = meld (heap, a, b);
+      pair->next = pairs;
+      pairs = pair;
+    }
+
+  /* Second pass, right to left. */
+  while (pairs != NULL)
+    {
+      struct heap_elem *pair = pairs;
+
+      pairs = pair->next;
+      pair->next = NULL;
+      root = meld (heap, root, pair);
+    }
+  return root;
+}
+
+/* Cuts ELEM, with its children, out of its parent's list of
+   children.  ELEM must not be a root. */
+static void
+cut (struct heap_elem *elem)
+{
+  ASSERT (elem->prev != NULL);
+
+  if (elem->prev->child == elem)
+    elem->prev->child = elem->next;
+  else
+    elem->prev->next = elem->next;
+  if (elem->next != NULL)
+    elem->next->prev = elem->prev;
+  elem->next = elem->prev = NULL;
+}
@@ -0,0 +1,79 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Pairing heap.
+
+   A pairing heap is a priority queue: it finds its smallest
+   element in O(1) time, inserts an element or moves one toward
+   the front in O(1) time, and removes an element in O(log n)
+   amortized time.  Like a struct list, it does not allocate
+   memory: each structure that is a potential element must embed
+   a struct heap_elem member, and the heap_entry macro converts a
+   struct heap_elem back to the structure that contains it.
+
+   The heap is ordered by a heap_less_func supplied to
+   heap_init(); the "smallest" element is the one that no other
+   element is less than.  Elements that compare equal come out in
+   no particular order, so a caller that needs ties broken in
+   insertion order must make that part of the comparison.
+
+   The key of an element in a heap may change only by calling
+   heap_promote() or heap_update() right afterward.
+
+   As with lists, there is no type checking: if you screw up, it
+   will bite you. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *child;    /* First child, or null. */
+    struct heap_elem *next;     /* Next sibling, or null. */
+    struct heap_elem *prev;     /* Previous sibling, or parent if the
+                                   first child, or null for the root. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)                   \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child            \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Pairing heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Smallest element, or null if empty. */
+    size_t size;                /* Number of elements. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+/* Insertion and removal. */
+void heap_insert (struct heap *, struct heap_elem *);
+void heap_remove (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop (struct heap *);
+
+/* Key changes. */
+void heap_promote (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+/* Properties. */
+struct heap_elem *heap_front (const struct heap *);
+size_t heap_size (const struct heap *);
+bool heap_empty (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
@@ -0,0 +1,396 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* Red-black tree, following the algorithms of [CLRS] chapter 13.
+   Missing children are null pointers, which count as black. */
+
+static void rotate_left (struct rbtree *, struct rb_elem *);
+static void rotate_right (struct rbtree *, struct rb_elem *);
+static void replace_child (struct rbtree *, struct rb_elem *parent,
+                           struct rb_elem *old, struct rb_elem *new);
+static void insert_fixup (struct rbtree *, struct rb_elem *);
+static void remove_fixup (struct rbtree *, struct rb_elem *,
+                          struct rb_elem *parent);
+static struct rb_elem *leftmost (struct rb_elem *);
+static struct rb_elem *rightmost (struct rb_elem *);
+
+/* Returns true if E is a red element, false if it is black or
+   null. */
+static inline bool
+is_red (const struct rb_elem *e)
+{
+  return e != NULL && e->red;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS given
+   auxiliary data AUX. */
+void
+rb_init (struct rbtree *tree, rb_less_func *less, void *aux)
+{
+  ASSERT (tree != NULL);
+  ASSERT (less != NULL);
+
+  tree->root = NULL;
+  tree->first = NULL;
+  tree->size = 0;
+  tree->less = less;
+  tree->aux = aux;
+}
+
+/* Inserts ELEM into TREE, after any elements equal to it. */
+void
+rb_insert (struct rbtree *tree, struct rb_elem *elem)
+{
+  struct rb_elem *parent = NULL;
+  struct rb_elem **link = &tree->root;
+  bool leftmost_path = true;
+
+  ASSERT (tree != NULL);
+  ASSERT (elem != NULL);
+
+  while (*link != NULL)
+    {
+      parent = *link;
+      if (tree->less (elem, parent, tree->aux))
+        link = &parent->left;
+      else
+        {
+          link = &parent->right;
+          leftmost_path = false;
+        }
+    }
+
+  elem->parent = parent;
+  elem->left = elem->right = NULL;
+  elem->red = true;
+  *link = elem;
+  if (leftmost_path)
+    tree->first = elem;
+  tree->size++;
+
+  insert_fixup (tree, elem);
+}
+
+/* Removes ELEM, which must be in TREE, from TREE. */
+void
+rb_remove (struct rbtree *tree, struct rb_elem *elem)
+{
+  struct rb_elem *child, *parent;
+  bool removed_red;
+
+  ASSERT (tree != NULL);
+  ASSERT (elem != NULL);
+  ASSERT (tree->size > 0);
+
+  if (tree->first == elem)
+    tree->first = rb_next (elem);
+
+  if (elem->left == NULL || elem->right == NULL)
+    {
+      /* ELEM has at most one child, which takes its place. */
+      child = elem->left != NULL ? elem->left : elem->right;
+      parent = elem->parent;
+      removed_red = elem->red;
+      if (child != NULL)
+        child->parent = parent;
+      replace_child (tree, parent, elem, child);
+    }
+  else
+    {
+      /* ELEM has two children.  Its successor, which has no left
+         child, takes its place, and the successor's right child
+         takes the successor's place. */
+      struct rb_elem *succ = leftmost (elem->right);
+
+      child = succ->right;
+      removed_red = succ->red;
+      if (succ->parent == elem)
+        parent = succ;
+      else
+        {
+          parent = succ->parent;
+          parent->left = child;
+          if (child != NULL)
+            child->parent = parent;
+          succ->right = elem->right;
+          succ->right->parent = succ;
+        }
+      succ->left = elem->left;
+      succ->left->parent = succ;
+      succ->parent = elem->parent;
+      succ->red = elem->red;
+      replace_child (tree, elem->parent, elem, succ);
+    }
+  tree->size--;
+
+  if (!removed_red)
+    remove_fixup (tree, child, parent);
+}
+
+/* Returns the smallest element in TREE, or a null pointer if TREE
+   is empty.  Takes constant time. */
+struct rb_elem *
+rb_first (const struct rbtree *tree)
+{
+  return tree->first;
+}
+
+/* Returns the largest element in TREE, or a null pointer if TREE
+   is empty. */
+struct rb_elem *
+rb_last (const struct rbtree *tree)
+{
+  return tree->root != NULL ? rightmost (tree->root) : NULL;
+}
+
+/* Returns the element after ELEM in its tree, or a null pointer
+   if ELEM is the largest. */
+struct rb_elem *
+rb_next (const struct rb_elem *elem)
+{
+  ASSERT (elem != NULL);
+
+  if (elem->right != NULL)
+    return leftmost (elem->right);
+  while (elem->parent != NULL && elem == elem->parent->right)
+    elem = elem->parent;
+  return elem->parent;
+}
+
+/* Returns the element before ELEM in its tree, or a null pointer
+   if ELEM is the smallest. */
+struct rb_elem *
+rb_prev (const struct rb_elem *elem)
+{
+  ASSERT (elem != NULL);
+
+  if (elem->left != NULL)
+    return rightmost (elem->left);
+  while (elem->parent != NULL && elem == elem->parent->left)
+    elem = elem->parent;
+  return elem->parent;
+}
+
+/* Returns the first element in TREE that is not less than KEY,
+   or a null pointer if there is none.  KEY need not be in
+   TREE. */
+struct rb_elem *
+rb_lower_bound (const struct rbtree *tree, const struct rb_elem *key)
+{
+  struct rb_elem *e = tree->root;
+  struct rb_elem *bound = NULL;
+
+  while (e != NULL)
+    if (tree->less (e, key, tree->aux))
+      e = e->right;
+    else
+      {
+        bound = e;
+        e = e->left;
+      }
+  return bound;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (const struct rbtree *tree)
+{
+  return tree->size;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rbtree *tree)
+{
+  return tree->root == NULL;
+}
+
+/* Makes NEW take OLD's place as a child of PARENT, or as the root
+   of TREE if PARENT is null. */
+static void
+replace_child (struct rbtree *tree, struct rb_elem *parent,
+               struct rb_elem *old, struct rb_elem *new)
+{
+  if (parent == NULL)
+    tree->root = new;
+  else if (parent->left == old)
+    parent->left = new;
+  else
+    parent->right = new;
+}
+
+/* Rotates the subtree rooted at X to the left, so that X's right
+   child takes its place. */
+static void
+rotate_left (struct rbtree *tree, struct rb_elem *x)
+{
+  struct rb_elem *y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+  y->parent = x->parent;
+  replace_child (tree, x->parent, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+/* Rotates the subtree rooted at X to the right, so that X's left
+   child takes its place. */
+static void
+rotate_right (struct rbtree *tree, struct rb_elem *x)
+{
+  struct rb_elem *y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+  y->parent = x->parent;
+  replace_child (tree, x->parent, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+/* Restores the red-black properties after red element E was
+   inserted into TREE. */
+static void
+insert_fixup (struct rbtree *tree, struct rb_elem *e)
+{
+  while (is_red (e->parent))
+    {
+      struct rb_elem *parent = e->parent;
+      struct rb_elem *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+        {
+          struct rb_elem *uncle = grandparent->right;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->right)
+            {
+              rotate_left (tree, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_right (tree, grandparent);
+        }
+      else
+        {
+          struct rb_elem *uncle = grandparent->left;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->left)
+            {
+              rotate_right (tree, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_left (tree, grandparent);
+        }
+    }
+  tree->root->red = false;
+}
+
+/* Restores the red-black properties after a black element was
+   removed from TREE.  E, which may be null, took its place as a
+   child of PARENT and is now one black element short. */
+static void
+remove_fixup (struct rbtree *tree, struct rb_elem *e, struct rb_elem *parent)
+{
+  while (e != tree->root && !is_red (e))
+    {
+      if (e == parent->left)
+        {
+          struct rb_elem *sibling = parent->right;
+          if (is_red (sibling))
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_left (tree, parent);
+              sibling = parent->right;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+              continue;
+            }
+          if (!is_red (sibling->right))
+            {
+              sibling->left->red = false;
+              sibling->red = true;
+              rotate_right (tree, sibling);
+              sibling = parent->right;
+            }
+          sibling->red = parent->red;
+          parent->red = false;
+          sibling->right->red = false;
+          rotate_left (tree, parent);
+        }
+      else
+        {
+          struct rb_elem *sibling = parent->left;
+          if (is_red (sibling))
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_right (tree, parent);
+              sibling = parent->left;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+              continue;
+            }
+          if (!is_red (sibling->left))
+            {
+              sibling->right->red = false;
+              sibling->red = true;
+              rotate_left (tree, sibling);
+              sibling = parent->left;
+            }
+          sibling->red = parent->red;
+          parent->red = false;
+          sibling->left->red = false;
+          rotate_right (tree, parent);
+        }
+      e = tree->root;
+    }
+  if (e != NULL)
+    e->red = false;
+}
+
+/* Returns the smallest element in the subtree rooted at E. */
+static struct rb_elem *
+leftmost (struct rb_elem *e)
+{
+  while (e->left != NULL)
+    e = e->left;
+  return e;
+}
+
+/* Returns the largest element in the subtree rooted at E. */
+static struct rb_elem *
+rightmost (struct rb_elem *e)
+{
+  while (e->right != NULL)
+    e = e->right;
+  return e;
+}
@@ -0,0 +1,216 @@
+/* Test program for lib/kernel/hash.c.
+
+   Inserts, replaces, and deletes random values in a chained hash
+   table and an open-addressing one, checking both against an
+   array of which values should be present, including while the
+   tables are being resized.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of distinct values. */
+#define VALUE_CNT 2048
+
+/* Number of random operations. */
+#define OP_CNT 100000
+
+/* A hash table element. */
+struct value
+  {
+    struct hash_elem elem;      /* Element of chained table. */
+    struct hash_elem oelem;     /* Element of open-addressing table. */
+    int value;                  /* Item value. */
+    bool present;               /* In both tables? */
+  };
+
+static unsigned value_hash (const struct hash_elem *, void *);
+static bool value_less (const struct hash_elem *, const struct hash_elem *,
+                        void *);
+static unsigned ovalue_hash (const struct hash_elem *, void *);
+static bool ovalue_less (const struct hash_elem *, const struct hash_elem *,
+                         void *);
+static void count_value (struct hash_elem *, void *);
+static void count_ovalue (struct hash_elem *, void *);
+static void verify (struct hash *, struct ohash *, struct value[]);
+
+/* Number of elements visited by count_value() or
+   count_ovalue(). */
+static size_t visit_cnt;
+
+/* Test the hash table implementations. */
+void
+test (void)
+{
+  static struct value values[VALUE_CNT];
+  static struct value copies[VALUE_CNT];
+  struct hash h;
+  struct ohash oh;
+  struct hash_stats stats;
+  int i;
+
+  ASSERT (hash_init (&h, value_hash, value_less, NULL));
+  ASSERT (ohash_init (&oh, ovalue_hash, ovalue_less, NULL));
+  for (i = 0; i < VALUE_CNT; i++)
+    {
+      values[i].value = copies[i].value = i;
+      values[i].present = false;
+    }
+
+  printf ("testing random operations:");
+  for (i = 0; i < OP_CNT; i++)
+    {
+      /* Favor insertions for the first half of the run and
+         only delete in the second, so that both tables grow to
+         hold most of the values and then shrink again. */
+      int grow = i < OP_CNT / 2 ? 3 : 0;
+      struct value *v = &values[random_ulong () % VALUE_CNT];
+      unsigned op = random_ulong () % 4;
+
+      if (op < (unsigned) grow)
+        {
+          struct hash_elem *old = hash_insert (&h, &v->elem);
+          struct hash_elem *oold = ohash_insert (&oh, &v->oelem);
+
+          ASSERT (v->present ? old == &v->elem : old == NULL);
+          ASSERT (v->present ? oold == &v->oelem : oold == NULL);
+          v->present = true;
+        }
+      else if (op == 3 && v->present)
+        {
+          /* Replace V by its copy and back again. */
+          struct value *c = &copies[v->value];
+
+          ASSERT (hash_replace (&h, &c->elem) == &v->elem);
+          ASSERT (ohash_replace (&oh, &c->oelem) == &v->oelem);
+          ASSERT (hash_replace (&h, &v->elem) == &c->elem);
+          ASSERT (ohash_replace (&oh, &v->oelem) == &c->oelem);
+        }
+      else
+        {
+          ASSERT (hash_delete (&h, &v->elem)
+                  == (v->present ? &v->elem : NULL));
+          ASSERT (ohash_delete (&oh, &v->oelem)
+                  == (v->present ? &v->oelem : NULL));
+          v->present = false;
+        }
+
+      if (i % (OP_CNT / 10) == 0)
+        printf (" %d", i);
+      if (i % 100 == 0)
+        verify (&h, &oh, values);
+      if (i == OP_CNT / 2)
+        {
+          /* Every present value is visited exactly once. */
+          visit_cnt = 0;
+          hash_apply (&h, count_value);
+          ASSERT (visit_cnt == hash_size (&h));
+          visit_cnt = 0;
+          ohash_apply (&oh, count_ovalue);
+          ASSERT (visit_cnt == ohash_size (&oh));
+
+          printf ("\n");
+          hash_get_stats (&h, &stats);
+          hash_print_stats (&stats, "chained");
+          ohash_get_stats (&oh, &stats);
+          hash_print_stats (&stats, "open addressing");
+        }
+    }
+  verify (&h, &oh, values);
+  printf (" done\n");
+
+  hash_get_stats (&h, &stats);
+  hash_print_stats (&stats, "chained");
+  ohash_get_stats (&oh, &stats);
+  hash_print_stats (&stats, "open addressing");
+
+  hash_clear (&h, NULL);
+  ohash_clear (&oh, NULL);
+  ASSERT (hash_empty (&h) && ohash_empty (&oh));
+  hash_destroy (&h, NULL);
+  ohash_destroy (&oh, NULL);
+
+  /* Check that the hash functions at least mix their input. */
+  ASSERT (hash_int (1) != hash_int (2));
+  ASSERT (hash_string ("abcdefg") != hash_string ("abcdefh"));
+  ASSERT (hash_string ("abcdefg") == hash_bytes ("abcdefg", 7));
+
+  printf ("hash: PASS\n");
+}
+
+/* Returns a hash of the value in chained element E. */
+static unsigned
+value_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct value, elem)->value);
+}
+
+/* Returns true if chained element A's value is less than B's. */
+static bool
+value_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct value, elem)->value
+          < hash_entry (b, struct value, elem)->value);
+}
+
+/* Returns a hash of the value in open-addressing element E. */
+static unsigned
+ovalue_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct value, oelem)->value);
+}
+
+/* Returns true if open-addressing element A's value is less than
+   B's. */
+static bool
+ovalue_less (const struct hash_elem *a, const struct hash_elem *b,
+             void *aux UNUSED)
+{
+  return (hash_entry (a, struct value, oelem)->value
+          < hash_entry (b, struct value, oelem)->value);
+}
+
+/* Counts chained element E, which must be present. */
+static void
+count_value (struct hash_elem *e, void *aux UNUSED)
+{
+  ASSERT (hash_entry (e, struct value, elem)->present);
+  visit_cnt++;
+}
+
+/* Counts open-addressing element E, which must be present. */
+static void
+count_ovalue (struct hash_elem *e, void *aux UNUSED)
+{
+  ASSERT (hash_entry (e, struct value, oelem)->present);
+  visit_cnt++;
+}
+
+/* Verifies that H and OH contain exactly the VALUES that are
+   marked present. */
+static void
+verify (struct hash *h, struct ohash *oh, struct value values[])
+{
+  size_t cnt = 0;
+  int i;
+
+  for (i = 0; i < VALUE_CNT; i++)
+    {
+      struct value *v = &values[i];
+
+      ASSERT (hash_find (h, &v->elem) == (v->present ? &v->elem : NULL));
+      ASSERT (ohash_find (oh, &v->oelem)
+              == (v->present ? &v->oelem : NULL));
+      cnt += v->present;
+    }
+  ASSERT (hash_size (h) == cnt);
+  ASSERT (ohash_size (oh) == cnt);
+}
@@ -0,0 +1,140 @@
+/* Test program for lib/kernel/heap.c.
+
+   Builds heaps of various sizes from values in random order,
+   changes some of their keys, removes some elements from the
+   middle, and checks that the rest come out in order.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <heap.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a heap that we will test. */
+#define MAX_SIZE 256
+
+/* A heap element. */
+struct value
+  {
+    struct heap_elem elem;      /* Heap element. */
+    int value;                  /* Item value. */
+    bool present;               /* In the heap? */
+  };
+
+static void shuffle (struct value *[], size_t);
+static bool value_less (const struct heap_elem *, const struct heap_elem *,
+                        void *);
+
+/* Test the pairing heap implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size heaps:");
+  for (size = 0; size < MAX_SIZE; size = size < 16 ? size + 1 : size * 2)
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++)
+        {
+          static struct value values[MAX_SIZE];
+          static struct value *order[MAX_SIZE];
+          struct heap heap;
+          struct heap_elem *e;
+          int i, cnt, prev;
+
+          /* Insert values 0...SIZE/2, each one twice, in random
+             order, checking the front as we go. */
+          for (i = 0; i < size; i++)
+            {
+              values[i].value = i / 2;
+              order[i] = &values[i];
+            }
+          shuffle (order, size);
+          heap_init (&heap, value_less, NULL);
+          ASSERT (heap_pop (&heap) == NULL);
+          for (i = 0; i < size; i++)
+            {
+              heap_insert (&heap, &order[i]->elem);
+              order[i]->present = true;
+              ASSERT (heap_entry (heap_front (&heap), struct value,
+                                  elem)->value <= order[i]->value);
+            }
+          ASSERT (heap_size (&heap) == (size_t) size);
+
+          /* Change the keys of a quarter of the elements, both up
+             and down, and remove another quarter. */
+          shuffle (order, size);
+          for (i = 0; i < size / 4; i++)
+            {
+              struct value *v = order[i];
+              int old = v->value;
+
+              v->value = random_ulong () % (size + 1) - 1;
+              if (v->value <= old)
+                heap_promote (&heap, &v->elem);
+              else
+                heap_update (&heap, &v->elem);
+            }
+          for (; i < size / 2; i++)
+            {
+              heap_remove (&heap, &order[i]->elem);
+              order[i]->present = false;
+            }
+          ASSERT (heap_size (&heap) == (size_t) (size - size / 2 + size / 4));
+
+          /* Pop the rest in order. */
+          cnt = 0;
+          prev = -1;
+          while ((e = heap_pop (&heap)) != NULL)
+            {
+              struct value *v = heap_entry (e, struct value, elem);
+
+              ASSERT (v->present);
+              ASSERT (v->value >= prev);
+              v->present = false;
+              prev = v->value;
+              cnt++;
+            }
+          ASSERT (cnt == size - size / 2 + size / 4);
+          ASSERT (heap_empty (&heap) && heap_size (&heap) == 0);
+        }
+    }
+
+  printf (" done\n");
+  printf ("heap: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void
+shuffle (struct value **array, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      struct value *t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct heap_elem *a_, const struct heap_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = heap_entry (a_, struct value, elem);
+  const struct value *b = heap_entry (b_, struct value, elem);
+
+  return a->value < b->value;
+}
@@ -0,0 +1,190 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Builds trees of various sizes from values in random order,
+   including runs of equal values, and checks the red-black
+   properties, ordered iteration in both directions, lower-bound
+   search, and removal.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <rbtree.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 256
+
+/* A tree element. */
+struct value
+  {
+    struct rb_elem elem;        /* Tree element. */
+    int value;                  /* Item value. */
+    int seq;                    /* Order of insertion. */
+  };
+
+static void shuffle (struct value *[], size_t);
+static bool value_less (const struct rb_elem *, const struct rb_elem *,
+                        void *);
+static int verify_subtree (const struct rb_elem *);
+static void verify_tree (struct rbtree *, size_t size);
+
+/* Test the red-black tree implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 0; size < MAX_SIZE; size = size < 16 ? size + 1 : size * 2)
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++)
+        {
+          static struct value values[MAX_SIZE];
+          static struct value *order[MAX_SIZE];
+          struct rbtree tree;
+          struct value key;
+          int i;
+
+          /* Insert values 0...SIZE/2, each one twice, in random
+             order. */
+          for (i = 0; i < size; i++)
+            {
+              values[i].value = i / 2;
+              order[i] = &values[i];
+            }
+          shuffle (order, size);
+          rb_init (&tree, value_less, NULL);
+          for (i = 0; i < size; i++)
+            {
+              order[i]->seq = i;
+              rb_insert (&tree, &order[i]->elem);
+            }
+          verify_tree (&tree, size);
+
+          /* Every key finds the first of its equal values, and
+             one past the largest finds nothing. */
+          for (i = 0; i <= (size + 1) / 2; i++)
+            {
+              struct rb_elem *e;
+
+              key.value = i;
+              e = rb_lower_bound (&tree, &key.elem);
+              if (i < (size + 1) / 2)
+                {
+                  struct rb_elem *prev = rb_prev (e);
+
+                  ASSERT (rb_entry (e, struct value, elem)->value == i);
+                  ASSERT (prev == NULL
+                          || rb_entry (prev, struct value, elem)->value < i);
+                }
+              else
+                ASSERT (e == NULL);
+            }
+
+          /* Remove a random half of the elements, then the rest. */
+          shuffle (order, size);
+          for (i = 0; i < size / 2; i++)
+            rb_remove (&tree, &order[i]->elem);
+          verify_tree (&tree, size - size / 2);
+          for (; i < size; i++)
+            rb_remove (&tree, &order[i]->elem);
+          verify_tree (&tree, 0);
+        }
+    }
+
+  printf (" done\n");
+  printf ("rbtree: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void
+shuffle (struct value **array, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      struct value *t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = rb_entry (a_, struct value, elem);
+  const struct value *b = rb_entry (b_, struct value, elem);
+
+  return a->value < b->value;
+}
+
+/* Verifies the links and the red-black properties of the subtree
+   rooted at E, and returns its black height. */
+static int
+verify_subtree (const struct rb_elem *e)
+{
+  int left_height, right_height;
+
+  if (e == NULL)
+    return 1;
+
+  ASSERT (e->left == NULL || e->left->parent == e);
+  ASSERT (e->right == NULL || e->right->parent == e);
+  ASSERT (!e->red || ((e->left == NULL || !e->left->red)
+                      && (e->right == NULL || !e->right->red)));
+
+  left_height = verify_subtree (e->left);
+  right_height = verify_subtree (e->right);
+  ASSERT (left_height == right_height);
+  return left_height + !e->red;
+}
+
+/* Verifies that TREE is a valid red-black tree of SIZE elements,
+   which come out in order, with equal values in order of
+   insertion, both forward and backward. */
+static void
+verify_tree (struct rbtree *tree, size_t size)
+{
+  const struct value *prev;
+  struct rb_elem *e;
+  size_t cnt;
+
+  ASSERT (rb_size (tree) == size);
+  ASSERT (rb_empty (tree) == (size == 0));
+  ASSERT (tree->root == NULL || (tree->root->parent == NULL
+                                 && !tree->root->red));
+  verify_subtree (tree->root);
+
+  prev = NULL;
+  cnt = 0;
+  for (e = rb_first (tree); e != NULL; e = rb_next (e))
+    {
+      const struct value *v = rb_entry (e, struct value, elem);
+
+      ASSERT (prev == NULL || prev->value < v->value
+              || (prev->value == v->value && prev->seq < v->seq));
+      prev = v;
+      cnt++;
+    }
+  ASSERT (cnt == size);
+  ASSERT (prev == (size ? rb_entry (rb_last (tree), struct value, elem)
+                   : NULL));
+
+  cnt = 0;
+  for (e = rb_last (tree); e != NULL; e = rb_prev (e))
+    cnt++;
+  ASSERT (cnt == size);
+}
@@ -0,0 +1,85 @@
+/* Arms callback timer events at a range of distances, including
+   ones far enough out that the timer wheel has to cascade them,
+   then cancels one, rearms another, and lets a third rearm
+   itself.  Verifies that every event fires on exactly the tick it
+   was armed for. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Distances, in ticks from the start of the test, at which the
+   events are first armed. */
+static const int delays[] = {1, 2, 63, 64, 65, 127, 128, 200, 300};
+#define EVENT_CNT (sizeof delays / sizeof *delays)
+
+/* Index of the event that gets cancelled, the one that gets
+   rearmed to REARM_DELAY, and the one that rearms itself every
+   PERIOD ticks, PERIOD_CNT times. */
+#define CANCELLED 5
+#define REARMED 7
+#define REARM_DELAY 100
+#define PERIODIC 0
+#define PERIOD 50
+#define PERIOD_CNT 3
+
+static struct timer_event events[EVENT_CNT];
+static int64_t fired_at[EVENT_CNT];
+static int fire_cnt[EVENT_CNT];
+static int64_t start;
+
+static timer_func record;
+
+void
+test_alarm_callback (void) 
+{
+  enum intr_level old_level;
+  size_t i;
+
+  /* Start right after a tick, and arm all the events on the same
+     tick. */
+  timer_sleep (1);
+  old_level = intr_disable ();
+  start = timer_ticks ();
+  for (i = 0; i < EVENT_CNT; i++)
+    {
+      timer_event_init (&events[i], record, &events[i]);
+      timer_event_arm (&events[i], start + delays[i]);
+    }
+  intr_set_level (old_level);
+
+  if (!timer_event_cancel (&events[CANCELLED]))
+    fail ("event %d was not pending", CANCELLED);
+  timer_event_arm (&events[REARMED], start + REARM_DELAY);
+
+  timer_sleep (start + 350 - timer_ticks ());
+
+  for (i = 0; i < EVENT_CNT; i++)
+    {
+      if (timer_event_pending (&events[i]))
+        fail ("event %zu still pending", i);
+      if (fire_cnt[i] == 0)
+        msg ("event %zu did not fire", i);
+      else
+        msg ("event %zu fired %d time(s), last after %"PRId64" ticks",
+             i, fire_cnt[i], fired_at[i] - start);
+    }
+  if (timer_event_cancel (&events[CANCELLED]))
+    fail ("cancelled event %d was still pending", CANCELLED);
+}
+
+/* Timer event function.  Records when event E_ fired, and rearms
+   the periodic event. */
+static void
+record (void *e_) 
+{
+  struct timer_event *e = e_;
+  size_t i = e - events;
+
+  fired_at[i] = timer_ticks ();
+  if (++fire_cnt[i] < PERIOD_CNT && i == PERIODIC)
+    timer_event_arm (e, fired_at[i] + PERIOD);
+}
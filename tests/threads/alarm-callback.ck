@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-callback) begin
+(alarm-callback) event 0 fired 3 time(s), last after 101 ticks
+(alarm-callback) event 1 fired 1 time(s), last after 2 ticks
+(alarm-callback) event 2 fired 1 time(s), last after 63 ticks
+(alarm-callback) event 3 fired 1 time(s), last after 64 ticks
+(alarm-callback) event 4 fired 1 time(s), last after 65 ticks
+(alarm-callback) event 5 did not fire
+(alarm-callback) event 6 fired 1 time(s), last after 128 ticks
+(alarm-callback) event 7 fired 1 time(s), last after 100 ticks
+(alarm-callback) event 8 fired 1 time(s), last after 300 ticks
+(alarm-callback) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Checks that sleeps shorter than a timer tick block the sleeping
+   thread, so that a lower-priority thread gets to run meanwhile,
+   and that they last at least as long as asked. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/clock.h"
+#include "devices/timer.h"
+
+static thread_func spinner;
+static volatile bool done;
+static volatile int64_t spins;
+static struct semaphore spinner_done;
+
+static void check_sleep (const char *name, void (*sleep) (int64_t),
+                         int64_t amount, int64_t ns);
+
+void
+test_alarm_usleep (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&spinner_done, 0);
+  thread_create ("spinner", PRI_DEFAULT - 1, spinner, NULL);
+
+  check_sleep ("timer_usleep", timer_usleep, 100, 100 * 1000);
+  check_sleep ("timer_usleep", timer_usleep, 500, 500 * 1000);
+  check_sleep ("timer_usleep", timer_usleep, 2000, 2000 * 1000);
+  check_sleep ("timer_usleep", timer_usleep, 15000, 15000 * 1000);
+  check_sleep ("timer_nsleep", timer_nsleep, 300000, 300000);
+
+  done = true;
+  sema_down (&spinner_done);
+}
+
+/* Sleeps with SLEEP for AMOUNT, that is, NS nanoseconds, and
+   reports how it went. */
+static void
+check_sleep (const char *name, void (*sleep) (int64_t),
+             int64_t amount, int64_t ns) 
+{
+  int64_t start_spins = spins;
+  int64_t start = clock_ns ();
+
+  sleep (amount);
+  msg ("%s (%"PRId64"): %s, %s", name, amount,
+       clock_ns () - start >= ns ? "long enough" : "too short",
+       spins != start_spins ? "blocked" : "did not block");
+}
+
+/* Spins until the test is done. */
+static void
+spinner (void *aux UNUSED) 
+{
+  while (!done)
+    spins++;
+  sema_up (&spinner_done);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-usleep) begin
+(alarm-usleep) timer_usleep (100): long enough, blocked
+(alarm-usleep) timer_usleep (500): long enough, blocked
+(alarm-usleep) timer_usleep (2000): long enough, blocked
+(alarm-usleep) timer_usleep (15000): long enough, blocked
+(alarm-usleep) timer_nsleep (300000): long enough, blocked
+(alarm-usleep) end
+EOF
+pass;
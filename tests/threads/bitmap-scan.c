@@ -0,0 +1,99 @@
+/* Benchmarks bitmap_scan() on a large, badly fragmented bitmap
+   against the bit-at-a-time scan that it replaced, with and
+   without a summary of full elements, and checks that all three
+   find the same groups.  Reports the time each one takes. */
+
+#include <bitmap.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "devices/clock.h"
+
+/* Number of bits in the bitmap. */
+#define BIT_CNT (128 * 1024)
+
+/* Number of scans timed for each group size. */
+#define SCAN_CNT 8
+
+/* Finds the first group of CNT bits at or after START that are
+   all set to VALUE, testing one bit at a time, as bitmap_scan()
+   used to. */
+static size_t
+bit_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, j;
+
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j) != value)
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Runs SCAN_CNT scans of B for groups of CNT unset bits, starting
+   at evenly spaced points, with bit_scan() if SLOW is true or
+   bitmap_scan() otherwise.  Stores the results in IDX[] and
+   returns the time taken in microseconds. */
+static int64_t
+time_scans (const struct bitmap *b, size_t cnt, bool slow, size_t idx[])
+{
+  int64_t start = clock_ns ();
+  int i;
+
+  for (i = 0; i < SCAN_CNT; i++)
+    {
+      size_t from = BIT_CNT / SCAN_CNT * i;
+      idx[i] = slow ? bit_scan (b, from, cnt, false)
+                    : bitmap_scan (b, from, cnt, false);
+    }
+  return (clock_ns () - start) / 1000;
+}
+
+void
+test_bitmap_scan (void) 
+{
+  static const size_t cnts[] = {1, 8, 64};
+  struct bitmap *b;
+  size_t i, j;
+
+  /* Mark everything, then free short holes all over the bitmap
+     and one long one near its end. */
+  b = bitmap_create (BIT_CNT);
+  if (b == NULL)
+    fail ("bitmap_create failed");
+  bitmap_set_all (b, true);
+  random_init (0);
+  for (i = 0; i + 8 < BIT_CNT - 1024; i += 64 + random_ulong () % 256)
+    bitmap_set_multiple (b, i, 1 + random_ulong () % 8, false);
+  bitmap_set_multiple (b, BIT_CNT - 512, 128, false);
+
+  for (i = 0; i < sizeof cnts / sizeof *cnts; i++)
+    {
+      size_t bit_idx[SCAN_CNT], word_idx[SCAN_CNT], summary_idx[SCAN_CNT];
+      int64_t bit_us, word_us, summary_us;
+
+      bit_us = time_scans (b, cnts[i], true, bit_idx);
+      word_us = time_scans (b, cnts[i], false, word_idx);
+      if (!bitmap_add_summary (b))
+        fail ("bitmap_add_summary failed");
+      summary_us = time_scans (b, cnts[i], false, summary_idx);
+      bitmap_destroy_summary (b);
+
+      for (j = 0; j < SCAN_CNT; j++)
+        if (word_idx[j] != bit_idx[j] || summary_idx[j] != bit_idx[j])
+          fail ("groups of %zu: scan %zu found %zu, %zu with summary, "
+                "expected %zu", cnts[i], j, word_idx[j], summary_idx[j],
+                bit_idx[j]);
+      msg ("groups of %zu: bit scan %"PRId64" us, word scan %"PRId64" us, "
+           "with summary %"PRId64" us",
+           cnts[i], bit_us, word_us, summary_us);
+    }
+  bitmap_destroy (b);
+  pass ();
+}
@@ -0,0 +1,90 @@
+/* Checks admission control, deadline-driven scheduling and budget
+   enforcement of periodic real-time threads.  A normal thread of
+   the highest priority spins throughout, which must not delay the
+   real-time thread, while an overrunning real-time thread must
+   not starve it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define JOB_CNT 10
+
+static thread_func rival;
+static thread_func hog;
+static struct semaphore helper_done;
+static volatile bool done;
+static volatile long long spins;
+
+void
+test_edf_periodic (void) 
+{
+  struct edf_stats before, after;
+  long long spins_before;
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&helper_done, 0);
+
+  /* Admission control. */
+  msg ("50%% utilization: %s",
+       thread_set_periodic (10, 5, 10) ? "admitted" : "rejected");
+  msg ("100%% utilization: %s",
+       thread_set_periodic (10, 10, 10) ? "admitted" : "rejected");
+  thread_create ("rival", PRI_DEFAULT, rival, NULL);
+  sema_down (&helper_done);
+
+  /* The hog has a higher priority than us, but we are real-time. */
+  done = false;
+  thread_create ("hog", PRI_MAX, hog, NULL);
+  thread_get_edf_stats (&before);
+  for (i = 0; i < JOB_CNT; i++)
+    thread_wait_period ();
+  thread_get_edf_stats (&after);
+  msg ("%lld jobs, %lld deadline misses",
+       after.jobs - before.jobs, after.misses - before.misses);
+
+  /* Overrun the budget for three periods. */
+  ASSERT (thread_set_periodic (10, 3, 10));
+  thread_get_edf_stats (&before);
+  spins_before = spins;
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 30)
+    continue;
+  thread_get_edf_stats (&after);
+  msg ("overrunning job: %s",
+       after.overruns - before.overruns >= 2 ? "throttled" : "not throttled");
+  msg ("normal thread: %s",
+       spins > spins_before ? "ran while throttled" : "starved");
+
+  done = true;
+  sema_down (&helper_done);
+  thread_clear_periodic ();
+}
+
+/* Tries to join the real-time class beside the main thread. */
+static void
+rival (void *aux UNUSED) 
+{
+  msg ("second thread at 50%%: %s",
+       thread_set_periodic (20, 10, 20) ? "admitted" : "rejected");
+  msg ("second thread at 40%%: %s",
+       thread_set_periodic (20, 8, 20) ? "admitted" : "rejected");
+  thread_clear_periodic ();
+  sema_up (&helper_done);
+}
+
+/* Spins until the test is done. */
+static void
+hog (void *aux UNUSED) 
+{
+  while (!done)
+    spins++;
+  sema_up (&helper_done);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-periodic) begin
+(edf-periodic) 50% utilization: admitted
+(edf-periodic) 100% utilization: rejected
+(edf-periodic) second thread at 50%: rejected
+(edf-periodic) second thread at 40%: admitted
+(edf-periodic) 10 jobs, 0 deadline misses
+(edf-periodic) overrunning job: throttled
+(edf-periodic) normal thread: ran while throttled
+(edf-periodic) end
+EOF
+pass;
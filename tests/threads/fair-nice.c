@@ -0,0 +1,72 @@
+/* Checks that the fair-share scheduler divides the CPU between
+   two busy threads in proportion to the weights of their nice
+   values.  A nice 0 thread should get about 1024 / 335, or a
+   little over 3, times the CPU time of a nice 5 thread. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPIN_TICKS (5 * TIMER_FREQ)
+
+struct spinner
+  {
+    int nice;                   /* Nice value to run with. */
+    int64_t run_ns;             /* CPU time used while spinning. */
+  };
+
+static thread_func spin;
+static int64_t start_time;
+static struct semaphore done;
+
+void
+test_fair_nice (void) 
+{
+  struct spinner spinners[2] = {{0, 0}, {5, 0}};
+  int64_t ratio;
+  int i;
+
+  ASSERT (scheduler == FAIR_SCHEDULER);
+
+  sema_init (&done, 0);
+  start_time = timer_ticks () + TIMER_FREQ;
+  for (i = 0; i < 2; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "nice %d", spinners[i].nice);
+      thread_create (name, PRI_DEFAULT, spin, &spinners[i]);
+    }
+  for (i = 0; i < 2; i++)
+    sema_down (&done);
+
+  ratio = spinners[0].run_ns * 100 / spinners[1].run_ns;
+  if (ratio >= 200 && ratio <= 450)
+    msg ("nice 0 thread got 2 to 4.5 times the CPU time of nice 5 thread");
+  else
+    msg ("nice 0 thread got %"PRId64".%02"PRId64" times the CPU time "
+         "of nice 5 thread", ratio / 100, ratio % 100);
+}
+
+/* Spins for SPIN_TICKS ticks starting at START_TIME and records
+   the CPU time it got meanwhile. */
+static void
+spin (void *spinner_) 
+{
+  struct spinner *spinner = spinner_;
+  struct schedstat before, after;
+
+  thread_set_nice (spinner->nice);
+  timer_sleep (start_time - timer_ticks ());
+
+  thread_get_schedstat (&before);
+  while (timer_ticks () < start_time + SPIN_TICKS)
+    continue;
+  thread_get_schedstat (&after);
+
+  spinner->run_ns = after.run_ns - before.run_ns;
+  sema_up (&done);
+}
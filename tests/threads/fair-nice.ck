@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fair-nice) begin
+(fair-nice) nice 0 thread got 2 to 4.5 times the CPU time of nice 5 thread
+(fair-nice) end
+EOF
+pass;
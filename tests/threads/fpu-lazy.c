@@ -0,0 +1,112 @@
+/* Checks that each thread's x87 and SSE registers survive
+   context switches to other threads that use them too, and that
+   the SSE2 page routines clear and copy pages correctly. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+#define THREAD_CNT 3
+#define SWITCH_CNT 10
+
+/* Pushes X onto the x87 register stack. */
+static void
+x87_push (int x)
+{
+  asm volatile ("fildl %0" : : "m" (x));
+}
+
+/* Returns the value on top of the x87 register stack. */
+static int
+x87_top (void)
+{
+  int x;
+  asm volatile ("fistl %0" : "=m" (x));
+  return x;
+}
+
+/* Loads X into XMM1. */
+static void
+sse_load (int x)
+{
+  asm volatile ("movd %0, %%xmm1" : : "r" (x));
+}
+
+/* Returns the low word of XMM1. */
+static int
+sse_read (void)
+{
+  int x;
+  asm volatile ("movd %%xmm1, %0" : "=r" (x));
+  return x;
+}
+
+struct fpu_thread
+  {
+    int value;                  /* Value to keep in the registers. */
+    bool ok;                    /* Still there after every switch? */
+    struct semaphore done;
+  };
+
+static void
+fpu_thread (void *t_) 
+{
+  struct fpu_thread *t = t_;
+  bool simd = fpu_simd_available ();
+  int i;
+
+  x87_push (t->value);
+  if (simd)
+    sse_load (t->value);
+  t->ok = true;
+  for (i = 0; i < SWITCH_CNT; i++)
+    {
+      thread_yield ();
+      if (x87_top () != t->value || (simd && sse_read () != t->value))
+        t->ok = false;
+    }
+  sema_up (&t->done);
+}
+
+void
+test_fpu_lazy (void) 
+{
+  struct fpu_thread threads[THREAD_CNT];
+  uint8_t *a, *b;
+  size_t i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      struct fpu_thread *t = &threads[i];
+
+      t->value = 1000 * (i + 1) + 7;
+      sema_init (&t->done, 0);
+      snprintf (name, sizeof name, "fpu %zu", i);
+      thread_create (name, PRI_DEFAULT, fpu_thread, t);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      sema_down (&threads[i].done);
+      msg ("thread %zu kept its FPU registers: %s.",
+           i, threads[i].ok ? "yes" : "no");
+    }
+
+  a = palloc_get_page (PAL_ASSERT);
+  b = palloc_get_page (PAL_ASSERT);
+  for (i = 0; i < PGSIZE; i++)
+    a[i] = i * 7;
+  fpu_copy_page (b, a);
+  msg ("Page copied: %s.", !memcmp (a, b, PGSIZE) ? "yes" : "no");
+  fpu_clear_page (b);
+  memset (a, 0, PGSIZE);
+  msg ("Page cleared: %s.", !memcmp (a, b, PGSIZE) ? "yes" : "no");
+  palloc_free_page (a);
+  palloc_free_page (b);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-lazy) begin
+(fpu-lazy) thread 0 kept its FPU registers: yes.
+(fpu-lazy) thread 1 kept its FPU registers: yes.
+(fpu-lazy) thread 2 kept its FPU registers: yes.
+(fpu-lazy) Page copied: yes.
+(fpu-lazy) Page cleared: yes.
+(fpu-lazy) end
+EOF
+pass;
@@ -0,0 +1,167 @@
+/* Benchmarks keeping elements in order with a sorted list, a
+   red-black tree and a pairing heap.  For each of several sizes,
+   inserts that many elements with random keys into each
+   container and then takes out the smallest until it is empty,
+   checks that all three yield the same sequence, and reports the
+   time each one takes. */
+
+#include <heap.h>
+#include <inttypes.h>
+#include <list.h>
+#include <random.h>
+#include <rbtree.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "devices/clock.h"
+
+/* Largest number of elements. */
+#define MAX_CNT 4096
+
+/* An element of all three containers. */
+struct value
+  {
+    struct list_elem list_elem;
+    struct rb_elem rb_elem;
+    struct heap_elem heap_elem;
+    int key;
+  };
+
+static bool list_key_less (const struct list_elem *, const struct list_elem *,
+                           void *);
+static bool rb_key_less (const struct rb_elem *, const struct rb_elem *,
+                         void *);
+static bool heap_key_less (const struct heap_elem *,
+                           const struct heap_elem *, void *);
+
+/* Inserts the CNT VALUES into a sorted list with
+   list_insert_ordered() and pops them off the front, storing them
+   in order into OUT[].  Returns the time taken in microseconds. */
+static int64_t
+time_list (struct value *values, size_t cnt, struct value **out)
+{
+  int64_t start = clock_ns ();
+  struct list list;
+  size_t i;
+
+  list_init (&list);
+  for (i = 0; i < cnt; i++)
+    list_insert_ordered (&list, &values[i].list_elem, list_key_less, NULL);
+  for (i = 0; i < cnt; i++)
+    out[i] = list_entry (list_pop_front (&list), struct value, list_elem);
+  return (clock_ns () - start) / 1000;
+}
+
+/* Does the same as time_list() with a red-black tree. */
+static int64_t
+time_rbtree (struct value *values, size_t cnt, struct value **out)
+{
+  int64_t start = clock_ns ();
+  struct rbtree tree;
+  size_t i;
+
+  rb_init (&tree, rb_key_less, NULL);
+  for (i = 0; i < cnt; i++)
+    rb_insert (&tree, &values[i].rb_elem);
+  for (i = 0; i < cnt; i++)
+    {
+      struct rb_elem *e = rb_first (&tree);
+      rb_remove (&tree, e);
+      out[i] = rb_entry (e, struct value, rb_elem);
+    }
+  return (clock_ns () - start) / 1000;
+}
+
+/* Does the same as time_list() with a pairing heap. */
+static int64_t
+time_heap (struct value *values, size_t cnt, struct value **out)
+{
+  int64_t start = clock_ns ();
+  struct heap heap;
+  size_t i;
+
+  heap_init (&heap, heap_key_less, NULL);
+  for (i = 0; i < cnt; i++)
+    heap_insert (&heap, &values[i].heap_elem);
+  for (i = 0; i < cnt; i++)
+    out[i] = heap_entry (heap_pop (&heap), struct value, heap_elem);
+  return (clock_ns () - start) / 1000;
+}
+
+void
+test_ordered_bench (void)
+{
+  static const size_t cnts[] = {16, 256, MAX_CNT};
+  struct value *values;
+  struct value **list_out, **rb_out, **heap_out;
+  size_t i, j;
+
+  values = malloc (sizeof *values * MAX_CNT);
+  list_out = malloc (sizeof *list_out * MAX_CNT);
+  rb_out = malloc (sizeof *rb_out * MAX_CNT);
+  heap_out = malloc (sizeof *heap_out * MAX_CNT);
+  if (values == NULL || list_out == NULL || rb_out == NULL
+      || heap_out == NULL)
+    fail ("out of memory");
+
+  /* Keys repeat, so that equal elements are ordered too. */
+  random_init (0);
+  for (i = 0; i < MAX_CNT; i++)
+    values[i].key = random_ulong () % (MAX_CNT / 4);
+
+  for (i = 0; i < sizeof cnts / sizeof *cnts; i++)
+    {
+      size_t cnt = cnts[i];
+      int64_t list_us, rb_us, heap_us;
+
+      list_us = time_list (values, cnt, list_out);
+      rb_us = time_rbtree (values, cnt, rb_out);
+      heap_us = time_heap (values, cnt, heap_out);
+
+      /* The list and the tree both keep equal elements in
+         insertion order; the heap does not. */
+      for (j = 0; j < cnt; j++)
+        if (rb_out[j] != list_out[j] || heap_out[j]->key != list_out[j]->key
+            || (j > 0 && list_out[j]->key < list_out[j - 1]->key))
+          fail ("%zu elements: element %zu out of order", cnt, j);
+      msg ("%zu elements: sorted list %"PRId64" us, red-black tree "
+           "%"PRId64" us, pairing heap %"PRId64" us",
+           cnt, list_us, rb_us, heap_us);
+    }
+
+  free (heap_out);
+  free (rb_out);
+  free (list_out);
+  free (values);
+  pass ();
+}
+
+/* Returns true if the value that list element A_ is in has a
+   smaller key than B_'s. */
+static bool
+list_key_less (const struct list_elem *a_, const struct list_elem *b_,
+               void *aux UNUSED)
+{
+  return (list_entry (a_, struct value, list_elem)->key
+          < list_entry (b_, struct value, list_elem)->key);
+}
+
+/* Returns true if the value that tree element A_ is in has a
+   smaller key than B_'s. */
+static bool
+rb_key_less (const struct rb_elem *a_, const struct rb_elem *b_,
+             void *aux UNUSED)
+{
+  return (rb_entry (a_, struct value, rb_elem)->key
+          < rb_entry (b_, struct value, rb_elem)->key);
+}
+
+/* Returns true if the value that heap element A_ is in has a
+   smaller key than B_'s. */
+static bool
+heap_key_less (const struct heap_elem *a_, const struct heap_elem *b_,
+               void *aux UNUSED)
+{
+  return (heap_entry (a_, struct value, heap_elem)->key
+          < heap_entry (b_, struct value, heap_elem)->key);
+}
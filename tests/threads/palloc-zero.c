@@ -0,0 +1,64 @@
+/* Checks that the idle thread fills the page allocator's reserve
+   of zeroed pages while the system is idle, and that PAL_ZERO
+   pages served from it, even ones that were freed dirty, are
+   filled with zeros. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 4
+
+/* Returns true if PAGE is filled with zeros. */
+static bool
+page_is_zero (const uint8_t *page)
+{
+  size_t i;
+
+  for (i = 0; i < PGSIZE; i++)
+    if (page[i] != 0)
+      return false;
+  return true;
+}
+
+void
+test_palloc_zero (void) 
+{
+  struct palloc_stats before, after;
+  uint8_t *pages[PAGE_CNT];
+  bool all_zero = true;
+  int i;
+
+  /* Dirty some pages and free them. */
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ASSERT);
+      memset (pages[i], 0xaa, PGSIZE);
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+
+  /* Let the idle thread work. */
+  timer_sleep (10);
+  palloc_get_stats (0, &before);
+  msg ("Reserve filled while idle: %s.",
+       before.zeroed_pages >= PAGE_CNT ? "yes" : "no");
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      if (!page_is_zero (pages[i]))
+        all_zero = false;
+    }
+  palloc_get_stats (0, &after);
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+
+  msg ("Pages zeroed: %s.", all_zero ? "yes" : "no");
+  msg ("Served from the reserve: %s.",
+       after.zero_hits - before.zero_hits == PAGE_CNT ? "yes" : "no");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-zero) begin
+(palloc-zero) Reserve filled while idle: yes.
+(palloc-zero) Pages zeroed: yes.
+(palloc-zero) Served from the reserve: yes.
+(palloc-zero) end
+EOF
+pass;
@@ -0,0 +1,75 @@
+/* The main thread acquires a reader-writer lock for reading.
+   Then it creates a higher-priority writer that blocks on the
+   lock, donating its priority to the main thread, and a reader
+   of even higher priority that must wait behind the writer even
+   though the lock is only held for reading, also donating.  When
+   the main thread releases the lock, the reader and then the
+   writer should get it, in priority order.  Finally, the main
+   thread checks upgrading and downgrading an uncontended lock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_priority_donate_rwlock (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_acquire_read (&rwlock);
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  thread_create ("reader", PRI_DEFAULT + 3, reader_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 3, thread_get_priority ());
+  rwlock_release (&rwlock);
+  msg ("reader, writer must already have finished, in that order.");
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+
+  rwlock_acquire_read (&rwlock);
+  msg ("upgrade: %s", rwlock_upgrade (&rwlock) ? "ok" : "failed");
+  msg ("write held after upgrade: %s",
+       rwlock_write_held_by_current_thread (&rwlock) ? "yes" : "no");
+  rwlock_downgrade (&rwlock);
+  msg ("write held after downgrade: %s",
+       rwlock_write_held_by_current_thread (&rwlock) ? "yes" : "no");
+  rwlock_release (&rwlock);
+  msg ("held after release: %s",
+       rwlock_held_by_current_thread (&rwlock) ? "yes" : "no");
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_write (rwlock);
+  msg ("writer: got the lock");
+  rwlock_release (rwlock);
+  msg ("writer: done");
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_read (rwlock);
+  msg ("reader: got the lock");
+  rwlock_release (rwlock);
+  msg ("reader: done");
+}
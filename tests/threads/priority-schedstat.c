@@ -0,0 +1,82 @@
+/* Checks that the scheduler statistics count voluntary switches,
+   involuntary switches and time spent waiting in the run
+   queue. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define YIELD_CNT 10
+
+static thread_func yielder;
+static thread_func spinner;
+static volatile bool done;
+static struct semaphore helper_done;
+
+void
+test_priority_schedstat (void) 
+{
+  struct schedstat before, after, total;
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&helper_done, 0);
+
+  /* Yielding to a thread of the same priority is voluntary. */
+  thread_create ("yielder", PRI_DEFAULT, yielder, NULL);
+  thread_get_schedstat (&before);
+  for (i = 0; i < YIELD_CNT; i++)
+    thread_yield ();
+  thread_get_schedstat (&after);
+  sema_down (&helper_done);
+  msg ("yielding: %s voluntary switches, %s involuntary switches",
+       after.nvcsw - before.nvcsw >= YIELD_CNT ? "counted" : "missing",
+       after.nivcsw == before.nivcsw ? "none" : "spurious");
+
+  /* Running through the end of the time slice while another
+     thread of the same priority is ready is not. */
+  done = false;
+  thread_create ("spinner", PRI_DEFAULT, spinner, NULL);
+  thread_get_schedstat (&before);
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 4 * TIMER_FREQ / 10)
+    continue;
+  done = true;
+  thread_get_schedstat (&after);
+  sema_down (&helper_done);
+  msg ("spinning: %s involuntary switches",
+       after.nivcsw > before.nivcsw ? "counted" : "missing");
+  msg ("spinning: %s run queue wait",
+       after.wait_ns > before.wait_ns ? "counted" : "missing");
+
+  thread_get_schedstat_total (&total, NULL, NULL);
+  msg ("system: %s switches",
+       total.nvcsw >= after.nvcsw && total.nivcsw >= after.nivcsw
+       ? "counted" : "missing");
+}
+
+/* Yields YIELD_CNT times. */
+static void
+yielder (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < YIELD_CNT; i++)
+    thread_yield ();
+  sema_up (&helper_done);
+}
+
+/* Spins until the test is done. */
+static void
+spinner (void *aux UNUSED) 
+{
+  while (!done)
+    continue;
+  sema_up (&helper_done);
+}
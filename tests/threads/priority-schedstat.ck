@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-schedstat) begin
+(priority-schedstat) yielding: counted voluntary switches, none involuntary switches
+(priority-schedstat) spinning: counted involuntary switches
+(priority-schedstat) spinning: counted run queue wait
+(priority-schedstat) system: counted switches
+(priority-schedstat) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Checks that an RCU callback is not run while a read-side
+   critical section that began before it was queued is still
+   going on, even across timer ticks, and that it has run once
+   synchronize_rcu() returns.  Also walks the thread list with
+   interrupts on. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/rcu.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static volatile bool reclaimed;
+
+static void
+reclaim (struct rcu_head *head UNUSED) 
+{
+  reclaimed = true;
+}
+
+static void
+find_current (struct thread *t, void *found_)
+{
+  bool *found = found_;
+
+  if (t == thread_current ())
+    *found = true;
+}
+
+void
+test_rcu_grace_period (void) 
+{
+  struct rcu_head head;
+  bool found = false;
+  int64_t start;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  rcu_read_lock ();
+  call_rcu (&head, reclaim);
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 5)
+    continue;
+  msg ("Reclaimed inside read-side critical section: %s.",
+       reclaimed ? "yes" : "no");
+  rcu_read_unlock ();
+
+  synchronize_rcu ();
+  msg ("Reclaimed after grace period: %s.", reclaimed ? "yes" : "no");
+
+  thread_foreach (find_current, &found);
+  msg ("thread_foreach found the running thread: %s.",
+       found ? "yes" : "no");
+}
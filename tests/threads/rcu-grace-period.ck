@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rcu-grace-period) begin
+(rcu-grace-period) Reclaimed inside read-side critical section: no.
+(rcu-grace-period) Reclaimed after grace period: yes.
+(rcu-grace-period) thread_foreach found the running thread: yes.
+(rcu-grace-period) end
+EOF
+pass;
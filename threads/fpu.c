@@ -0,0 +1,390 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Lazy switching works through CR0.TS.  While TS is set, the
+   first x87, MMX or SSE instruction raises #NM, the "device not
+   available" exception.  Every context switch sets TS; the #NM
+   handler clears it and loads the running thread's state.  So
+   TS is clear only while the registers hold state that the
+   running thread may have changed since it was last saved, and
+   the next context switch saves it.
+
+   Each CPU remembers in fpu_owner whose state its registers
+   still hold, and each thread remembers in fpu_cpu which CPU
+   last loaded its state, so that a thread that uses the FPU
+   again on the same CPU, with no one else having used it in
+   between, does not need to reload it.
+
+   All of this happens with interrupts off. */
+
+/* CR0 bits. */
+#define CR0_MP 0x00000002       /* Monitor Coprocessor. */
+#define CR0_EM 0x00000004       /* (Floating-point) Emulation. */
+#define CR0_TS 0x00000008       /* Task Switched. */
+#define CR0_NE 0x00000020       /* Numeric Error. */
+
+/* CR4 bits. */
+#define CR4_OSFXSR 0x00000200   /* fxsave, fxrstor and SSE enabled. */
+#define CR4_OSXMMEXCPT 0x00000400 /* SSE exceptions raise #XF. */
+
+/* CPUID function 1 EDX bits. */
+#define CPUID_FPU (1u << 0)     /* x87 FPU. */
+#define CPUID_FXSR (1u << 24)   /* fxsave and fxrstor. */
+#define CPUID_SSE (1u << 25)    /* SSE. */
+#define CPUID_SSE2 (1u << 26)   /* SSE2. */
+
+/* Initial MXCSR: all SSE exceptions masked, round to nearest. */
+#define MXCSR_DEFAULT 0x1f80
+
+/* Saved FPU state.  In the format of fxsave, or of fnsave in its
+   first 108 bytes if the CPU does not have fxsave. */
+struct fpu_state
+  {
+    uint8_t regs[512];
+  }
+__attribute__ ((aligned (16)));
+
+/* What the CPU has. */
+static bool have_fpu;
+static bool have_fxsr;
+static bool have_sse;
+static bool have_sse2;
+
+/* State of a thread that has not used the FPU yet. */
+static struct fpu_state initial_state;
+
+/* Statistics. */
+static long long trap_cnt;      /* #NM exceptions. */
+static long long restore_cnt;   /* States loaded. */
+static long long save_cnt;      /* States saved. */
+static long long simd_cnt;      /* Kernel SIMD regions. */
+
+static intr_handler_func fpu_trap;
+
+static inline uint32_t
+read_cr0 (void)
+{
+  uint32_t cr0;
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  return cr0;
+}
+
+static inline void
+write_cr0 (uint32_t cr0)
+{
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0));
+}
+
+/* Sets CR0.TS, so that the next FPU instruction raises #NM. */
+static inline void
+set_ts (void)
+{
+  uint32_t cr0 = read_cr0 ();
+  if ((cr0 & CR0_TS) == 0)
+    write_cr0 (cr0 | CR0_TS);
+}
+
+/* Saves the FPU registers into S.  Without fxsave, this also
+   reinitializes them, so the current CPU no longer holds anyone's
+   state. */
+static void
+save (struct fpu_state *s)
+{
+  if (have_fxsr)
+    asm volatile ("fxsave %0" : "=m" (*s));
+  else
+    {
+      asm volatile ("fnsave %0; fwait" : "=m" (*s));
+      cpu_current ()->fpu_owner = NULL;
+    }
+  save_cnt++;
+}
+
+/* Loads the FPU registers from S. */
+static void
+restore (const struct fpu_state *s)
+{
+  if (have_fxsr)
+    asm volatile ("fxrstor %0" : : "m" (*s));
+  else
+    asm volatile ("frstor %0" : : "m" (*s));
+  restore_cnt++;
+}
+
+/* Turns on the FPU, and SSE if available, on the current CPU,
+   with CR0.TS set. */
+static void
+setup_cpu (void)
+{
+  write_cr0 ((read_cr0 () & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+  if (have_fxsr)
+    {
+      uint32_t cr4;
+
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      cr4 |= CR4_OSFXSR;
+      if (have_sse)
+        cr4 |= CR4_OSXMMEXCPT;
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+    }
+}
+
+/* Detects the FPU and SSE, turns them on for the bootstrap
+   processor, and installs the #NM handler.  Without an FPU,
+   which leaves CR0.EM set, the handler treats #NM like any other
+   fault. */
+void
+fpu_init (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  have_fpu = (edx & CPUID_FPU) != 0;
+  have_fxsr = have_fpu && (edx & CPUID_FXSR) != 0;
+  have_sse = have_fxsr && (edx & CPUID_SSE) != 0;
+  have_sse2 = have_sse && (edx & CPUID_SSE2) != 0;
+
+  intr_register_int (7, 0, INTR_OFF, fpu_trap,
+                     "#NM Device Not Available Exception");
+  if (!have_fpu)
+    return;
+
+  /* Capture the state of a freshly initialized FPU. */
+  setup_cpu ();
+  asm volatile ("clts; fninit");
+  if (have_sse)
+    {
+      uint32_t mxcsr = MXCSR_DEFAULT;
+      asm volatile ("ldmxcsr %0" : : "m" (mxcsr));
+    }
+  save (&initial_state);
+  set_ts ();
+  save_cnt = 0;
+
+  printf ("FPU: x87%s%s, lazy switching enabled.\n",
+          have_sse ? ", SSE" : "", have_sse2 ? ", SSE2" : "");
+}
+
+/* Turns on the FPU for an application processor. */
+void
+fpu_init_ap (void)
+{
+  if (have_fpu)
+    setup_cpu ();
+}
+
+/* Kills the running thread for using an FPU that we cannot give
+   it, or panics if it is in the kernel. */
+static void
+no_fpu (struct intr_frame *f, const char *why)
+{
+  if (f->cs == SEL_KCSEG)
+    PANIC ("Kernel used the FPU at %p: %s", f->eip, why);
+  printf ("%s: dying due to interrupt %#04x (%s): %s.\n",
+          thread_name (), f->vec_no, intr_name (f->vec_no), why);
+  intr_enable ();
+  thread_exit (); 
+}
+
+/* #NM handler.  Gives the FPU to the running thread, loading its
+   state unless the registers still hold it. */
+static void
+fpu_trap (struct intr_frame *f)
+{
+  struct thread *cur = thread_current ();
+  struct cpu *cpu;
+
+  if (!have_fpu)
+    no_fpu (f, "no FPU");
+  trap_cnt++;
+
+  if (cur->fpu == NULL)
+    {
+      /* First use.  Allocating may sleep, and we may be moved to
+         another CPU meanwhile, but our state is not in anyone's
+         registers yet. */
+      void *mem;
+
+      intr_enable ();
+      mem = malloc (sizeof (struct fpu_state) + 15);
+      intr_disable ();
+      if (mem == NULL)
+        no_fpu (f, "out of memory for FPU state");
+      cur->fpu_mem = mem;
+      cur->fpu = (struct fpu_state *) (((uintptr_t) mem + 15) & ~15u);
+      memcpy (cur->fpu, &initial_state, sizeof *cur->fpu);
+      cur->fpu_cpu = NULL;
+    }
+
+  cpu = cpu_current ();
+  asm volatile ("clts");
+  if (cpu->fpu_owner != cur || cur->fpu_cpu != cpu)
+    {
+      restore (cur->fpu);
+      cpu->fpu_owner = cur;
+      cur->fpu_cpu = cpu;
+    }
+}
+
+/* Called on every context switch, on the new thread, with PREV
+   the thread switched from or a null pointer if there was no
+   switch.  Saves PREV's state if it used the FPU during its time
+   slice, and arranges for the next FPU instruction to trap. */
+void
+fpu_switch (struct thread *prev)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!have_fpu || prev == NULL || (read_cr0 () & CR0_TS) != 0)
+    return;
+  if (prev->fpu != NULL)
+    save (prev->fpu);
+  set_ts ();
+}
+
+/* Frees the running thread's FPU state.  Called when it exits. */
+void
+fpu_thread_exit (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  void *mem;
+  int i;
+
+  if (cur->fpu == NULL)
+    return;
+
+  old_level = intr_disable ();
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].fpu_owner == cur)
+      cpus[i].fpu_owner = NULL;
+  mem = cur->fpu_mem;
+  cur->fpu = cur->fpu_mem = NULL;
+  intr_set_level (old_level);
+
+  free (mem);
+}
+
+/* Returns true if the kernel may use SSE2 instructions between
+   fpu_begin() and fpu_end(). */
+bool
+fpu_simd_available (void)
+{
+  return have_sse2;
+}
+
+/* Begins a region of kernel code that uses the FPU or SSE
+   registers, saving the running thread's state first if need be.
+   Turns interrupts off until fpu_end(), which must be passed the
+   return value.  Regions do not nest. */
+enum intr_level
+fpu_begin (void)
+{
+  enum intr_level old_level = intr_disable ();
+  struct cpu *cpu = cpu_current ();
+
+  ASSERT (have_fpu);
+  ASSERT (!cpu->fpu_kernel);
+
+  if ((read_cr0 () & CR0_TS) == 0)
+    {
+      struct thread *cur = thread_current ();
+      if (cur->fpu != NULL)
+        save (cur->fpu);
+    }
+  else
+    asm volatile ("clts");
+  cpu->fpu_owner = NULL;
+  cpu->fpu_kernel = true;
+  simd_cnt++;
+  return old_level;
+}
+
+/* Ends a region begun with fpu_begin(), which returned
+   OLD_LEVEL. */
+void
+fpu_end (enum intr_level old_level)
+{
+  struct cpu *cpu = cpu_current ();
+
+  ASSERT (cpu->fpu_kernel);
+
+  cpu->fpu_kernel = false;
+  set_ts ();
+  intr_set_level (old_level);
+}
+
+/* Fills the page at PAGE, which must be page-aligned, with
+   zeros, 64 bytes at a time with SSE2 if available. */
+void
+fpu_clear_page (void *page)
+{
+  enum intr_level old_level;
+  uint8_t *p = page;
+  int i;
+
+  if (!have_sse2)
+    {
+      pg_clear (page);
+      return;
+    }
+  ASSERT (pg_ofs (page) == 0);
+
+  old_level = fpu_begin ();
+  asm volatile ("pxor %%xmm0, %%xmm0" : : : "memory");
+  for (i = 0; i < PGSIZE; i += 64)
+    asm volatile ("movdqa %%xmm0, 0(%0)\n\t"
+                  "movdqa %%xmm0, 16(%0)\n\t"
+                  "movdqa %%xmm0, 32(%0)\n\t"
+                  "movdqa %%xmm0, 48(%0)"
+                  : : "r" (p + i) : "memory");
+  fpu_end (old_level);
+}
+
+/* Copies the page at SRC to DST, which must both be
+   page-aligned, 64 bytes at a time with SSE2 if available. */
+void
+fpu_copy_page (void *dst, const void *src)
+{
+  enum intr_level old_level;
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+  int i;
+
+  if (!have_sse2)
+    {
+      pg_copy (dst, src);
+      return;
+    }
+  ASSERT (pg_ofs (dst) == 0 && pg_ofs (src) == 0);
+
+  old_level = fpu_begin ();
+  for (i = 0; i < PGSIZE; i += 64)
+    asm volatile ("movdqa 0(%1), %%xmm0\n\t"
+                  "movdqa 16(%1), %%xmm1\n\t"
+                  "movdqa 32(%1), %%xmm2\n\t"
+                  "movdqa 48(%1), %%xmm3\n\t"
+                  "movdqa %%xmm0, 0(%0)\n\t"
+                  "movdqa %%xmm1, 16(%0)\n\t"
+                  "movdqa %%xmm2, 32(%0)\n\t"
+                  "movdqa %%xmm3, 48(%0)"
+                  : : "r" (d + i), "r" (s + i) : "memory");
+  fpu_end (old_level);
+}
+
+/* Prints FPU statistics. */
+void
+fpu_print_stats (void)
+{
+  printf ("FPU: %lld traps, %lld restores, %lld saves, "
+          "%lld kernel SIMD regions\n",
+          trap_cnt, restore_cnt, save_cnt, simd_cnt);
+}
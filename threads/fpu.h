@@ -0,0 +1,42 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* Floating-point unit.
+
+   Any thread may use the x87 FPU and, if the CPU has them, the
+   SSE registers.  Their state is switched lazily: a thread gets
+   a save area the first time it uses them, its state is loaded
+   only when it next uses them after a context switch, and it is
+   saved at the next context switch only if it did.
+
+   That includes kernel threads, which may use these registers
+   directly and have them switched through the #NM trap like any
+   other thread.  The first use allocates the save area and may
+   sleep, so code that must not sleep, such as an interrupt
+   handler or code run with interrupts off, uses them only
+   between fpu_begin() and fpu_end() instead.  The kernel itself
+   is compiled with -msoft-float, so either way kernel code
+   reaches these registers only through inline assembly. */
+
+struct thread;
+
+void fpu_init (void);
+void fpu_init_ap (void);
+void fpu_switch (struct thread *prev);
+void fpu_thread_exit (void);
+
+/* Kernel SIMD regions. */
+bool fpu_simd_available (void);
+enum intr_level fpu_begin (void);
+void fpu_end (enum intr_level);
+
+/* SSE2 page operations, with plain fallbacks. */
+void fpu_clear_page (void *page);
+void fpu_copy_page (void *dst, const void *src);
+
+void fpu_print_stats (void);
+
+#endif /* threads/fpu.h */
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "devices/clock.h"
 #include "devices/kbd.h"
 #include "devices/input.h"
 #include "devices/serial.h"
@@ -15,12 +16,16 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -54,6 +59,13 @@ static const char *swap_bdev_name;
 #endif
 #endif /* FILESYS */
 
+/* -irqsoff: Trace interrupts-off latency? */
+static bool trace_irqsoff;
+
+/* -profile: Sample the running code?  With call chains? */
+static bool profile;
+static bool profile_chains;
+
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
@@ -97,7 +109,10 @@ main (void)
   /* Initialize memory system. */
   palloc_init (user_page_limit);
   malloc_init ();
+  slab_init ();
   paging_init ();
+  if (profile)
+    profile_init (profile_chains);
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -107,6 +122,7 @@ main (void)
 
   /* Initialize interrupt handlers. */
   intr_init ();
+  fpu_init ();
   timer_init ();
   kbd_init ();
   input_init ();
@@ -119,6 +135,12 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  clock_init ();
+  if (trace_irqsoff)
+    intr_trace_start ();
+
+  /* Bring up the other processors, if any. */
+  smp_init ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -259,6 +281,23 @@ parse_options (char **argv)
           thread_mlfqs = true;
           scheduler = MLFQ_SCHEDULER;
         }
+      else if (!strcmp (name, "-fair"))
+        {
+          thread_mlfqs = false;
+          scheduler = FAIR_SCHEDULER;
+        }
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-irqsoff"))
+        trace_irqsoff = true;
+      else if (!strcmp (name, "-profile"))
+        {
+          profile = true;
+          if (value != NULL && !strcmp (value, "chains"))
+            profile_chains = true;
+          else if (value != NULL)
+            PANIC ("unknown profile mode `%s'", value);
+        }
         
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
@@ -383,6 +422,10 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -fair              Use proportional-share scheduler.\n"
+          "  -tickless          Stop the timer interrupt while idle.\n"
+          "  -irqsoff           Trace interrupts-off latency.\n"
+          "  -profile[=chains]  Sample running code, with call chains.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -3,11 +3,16 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/clock.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 
 /* Programmable Interrupt Controller (PIC) registers.
@@ -43,9 +48,68 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  Each CPU keeps track of its own external
+   interrupt in its struct cpu. */
+
+/* Global interrupt lock.
+
+   Kernel code protects shared data by turning interrupts off,
+   which only excludes other code on the same CPU.  To keep that
+   working with several CPUs, a CPU holds this lock whenever its
+   interrupts are off, so that at most one CPU at a time runs with
+   interrupts off.  intr_disable() and intr_enable() take and drop
+   the lock along with the interrupt flag, and intr_handler() does
+   the same for interrupt gates, which turn interrupts off
+   behind our back.
+
+   On a uniprocessor the lock is never contended. */
+static struct spinlock intr_lock = SPINLOCK_INITIALIZER;
+
+/* Interrupts-off latency tracer.
+
+   Once started, every stretch of code that runs with interrupts
+   off is timed with the time-stamp counter, from the `cli' or
+   interrupt gate that begins it to the `sti' or `iret' that ends
+   it.  Each section is charged to the place that turned
+   interrupts off: the caller of intr_disable() or
+   intr_set_level(), or the handler of the interrupt.  For each
+   place, the tracer keeps the number of sections, their total
+   length, and the longest one along with its call stack.
+
+   A section may begin in one thread and end in another, because
+   schedule() runs with interrupts off; it is charged to the place
+   where it began.  A CPU holds the interrupt lock whenever its
+   interrupts are off, so at most one section is open at a time
+   and the interrupt lock protects all of the tracer's state.
+   Time spent spinning for the lock counts too, since interrupts
+   are already off then. */
+#define OFF_SITES 128                   /* Size of off_sites[], a power of 2. */
+
+/* Interrupts-off sections begun at one place, in TSC cycles. */
+struct off_site
+  {
+    void *site;                         /* Where interrupts went off. */
+    long long count;                    /* Number of sections. */
+    uint64_t total;                     /* Total length of the sections. */
+    uint64_t max;                       /* Length of the longest. */
+    void *backtrace[INTR_OFF_DEPTH];    /* Call stack of the longest. */
+  };
+
+static bool tracing;                    /* Timing interrupts-off sections? */
+static struct off_site off_sites[OFF_SITES];
+static long long off_sections;          /* Sections timed. */
+static long long off_untracked;         /* Of those, with no room in off_sites. */
+
+/* The open section.  OFF_BACKTRACE[0] is the place it began, or
+   a null pointer if it is not being timed. */
+static uint64_t off_start;
+static void *off_backtrace[INTR_OFF_DEPTH];
+
+static void off_begin (uint64_t start, void *site, void **frame);
+static void off_end (void);
+static struct off_site *off_lookup (void *site);
+
+static enum intr_level disable (void **frame);
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -80,7 +144,9 @@ intr_get_level (void)
 enum intr_level
 intr_set_level (enum intr_level level) 
 {
-  return level == INTR_ON ? intr_enable () : intr_disable ();
+  return (level == INTR_ON
+          ? intr_enable ()
+          : disable (__builtin_frame_address (0)));
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
@@ -90,6 +156,12 @@ intr_enable (void)
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (old_level == INTR_OFF)
+    {
+      off_end ();
+      spinlock_release (&intr_lock);
+    }
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -102,16 +174,55 @@ intr_enable (void)
 /* Disables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_disable (void) 
+{
+  return disable (__builtin_frame_address (0));
+}
+
+/* Disables interrupts and returns the previous interrupt status,
+   on behalf of the function whose stack frame is FRAME. */
+static enum intr_level
+disable (void **frame)
 {
   enum intr_level old_level = intr_get_level ();
+  uint64_t start = tracing ? clock_cycles () : 0;
 
   /* Disable interrupts by clearing the interrupt flag.
      See [IA32-v2b] "CLI" and [IA32-v3a] 5.8.1 "Masking Maskable
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (old_level == INTR_ON)
+    {
+      spinlock_acquire (&intr_lock);
+      if (tracing)
+        off_begin (start, frame[1], frame[0]);
+    }
+
   return old_level;
 }
+
+/* Enables interrupts and waits for the next one to arrive.
+   Interrupts must be off on entry; they are on when this function
+   returns, after the interrupt has been handled.
+
+   The `sti' instruction disables interrupts until the completion
+   of the next instruction, so `sti; hlt' is executed atomically.
+   This atomicity is important; otherwise, an interrupt could be
+   handled between re-enabling interrupts and waiting for the next
+   one to occur, wasting as much as one clock tick worth of time.
+
+   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a] 7.11.1
+   "HLT Instruction". */
+void
+intr_wait (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!intr_context ());
+
+  off_end ();
+  spinlock_release (&intr_lock);
+  asm volatile ("sti; hlt" : : : "memory");
+}
 
 /* Initializes the interrupt system. */
 void
@@ -133,6 +244,10 @@ intr_init (void)
   idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
   asm volatile ("lidt %0" : : "m" (idtr_operand));
 
+  /* Interrupts are off, so we should be holding the interrupt
+     lock. */
+  spinlock_acquire (&intr_lock);
+
   /* Initialize intr_names. */
   for (i = 0; i < INTR_CNT; i++)
     intr_names[i] = "unknown";
@@ -157,6 +272,21 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Initializes the interrupt system on an application processor,
+   which shares the bootstrap processor's IDT.  Interrupts must
+   be off. */
+void
+intr_init_ap (void)
+{
+  uint64_t idtr_operand;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+  spinlock_acquire (&intr_lock);
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -174,6 +304,14 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
   intr_names[vec_no] = name;
 }
 
+/* Returns true if VEC_NO is an external interrupt, that is, one
+   delivered by the PICs or by a local APIC. */
+static bool
+is_external (uint8_t vec_no)
+{
+  return (vec_no >= 0x20 && vec_no <= 0x2f) || vec_no >= LAPIC_TIMER_VEC;
+}
+
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
    execute with interrupts disabled. */
@@ -181,7 +319,7 @@ void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
                    const char *name) 
 {
-  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT (is_external (vec_no));
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -202,7 +340,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
-  ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (!is_external (vec_no));
   register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -211,7 +349,11 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  /* Interrupts are always off in an external interrupt, and
+     checking first keeps this cheap. */
+  if (intr_get_level () == INTR_ON)
+    return false;
+  return cpu_current ()->in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -222,7 +364,7 @@ void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  cpu_current ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -344,28 +486,42 @@ make_idtr_operand (uint16_t limit, void *base)
 void
 intr_handler (struct intr_frame *frame) 
 {
+  struct cpu *cpu;
   bool external;
-  intr_handler_func *handler;
+  intr_handler_func *handler = intr_handlers[frame->vec_no];
+
+  /* An interrupt gate turned interrupts off, so take the
+     interrupt lock to match. */
+  if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+    {
+      uint64_t start = tracing ? clock_cycles () : 0;
+
+      spinlock_acquire (&intr_lock);
+      if (tracing)
+        off_begin (start, handler != NULL ? (void *) handler : intr_handler,
+                   NULL);
+    }
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+     and they need to be acknowledged on the PIC or local APIC
+     (see below).  An external interrupt handler cannot sleep. */
+  external = is_external (frame->vec_no);
+  cpu = cpu_current ();
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
-      in_external_intr = true;
-      yield_on_return = false;
+      cpu->in_external_intr = true;
+      cpu->yield_on_return = false;
     }
 
   /* Invoke the interrupt's handler. */
-  handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == LAPIC_SPURIOUS_VEC)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -380,11 +536,21 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      cpu->in_external_intr = false;
+      if (frame->vec_no < 0x30)
+        pic_end_of_interrupt (frame->vec_no); 
+      else if (frame->vec_no != LAPIC_SPURIOUS_VEC)
+        lapic_eoi ();
+
+      if (cpu->yield_on_return) 
+        thread_preempt (); 
+    }
 
-      if (yield_on_return) 
-        thread_yield (); 
+  /* Returning from the interrupt turns interrupts back on. */
+  if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+    {
+      off_end ();
+      spinlock_release (&intr_lock);
     }
 }
 
@@ -436,3 +602,160 @@ intr_name (uint8_t vec)
 {
   return intr_names[vec];
 }
+
+/* Interrupts-off latency tracer. */
+
+/* Starts timing interrupts-off sections, if the time-stamp
+   counter is available.  Must be called after clock_init(). */
+void
+intr_trace_start (void)
+{
+  if (clock_is_precise ())
+    tracing = true;
+  else
+    printf ("Interrupts-off tracing needs a time-stamp counter.\n");
+}
+
+/* Stores statistics for up to CNT of the places that turned
+   interrupts off for the longest into STATS[], longest first, and
+   returns the number stored. */
+size_t
+intr_off_top (struct intr_off_stat *stats, size_t cnt)
+{
+  bool taken[OFF_SITES];
+  enum intr_level old_level;
+  size_t n;
+
+  old_level = intr_disable ();
+  memset (taken, 0, sizeof taken);
+  for (n = 0; n < cnt; n++)
+    {
+      struct off_site *best = NULL;
+      struct intr_off_stat *st = &stats[n];
+      int i;
+
+      for (i = 0; i < OFF_SITES; i++)
+        if (off_sites[i].site != NULL && !taken[i]
+            && (best == NULL || off_sites[i].max > best->max))
+          best = &off_sites[i];
+      if (best == NULL)
+        break;
+      taken[best - off_sites] = true;
+
+      st->site = best->site;
+      st->count = best->count;
+      st->total_ns = clock_cycles_to_ns (best->total);
+      st->max_ns = clock_cycles_to_ns (best->max);
+      memcpy (st->backtrace, best->backtrace, sizeof st->backtrace);
+    }
+  intr_set_level (old_level);
+  return n;
+}
+
+/* Forgets all the interrupts-off sections recorded so far. */
+void
+intr_off_reset (void)
+{
+  enum intr_level old_level = intr_disable ();
+  memset (off_sites, 0, sizeof off_sites);
+  off_sections = off_untracked = 0;
+  intr_set_level (old_level);
+}
+
+/* Prints the places that turned interrupts off for the longest,
+   with the call stack of each one's longest section. */
+void
+intr_print_stats (void)
+{
+  static struct intr_off_stat top[10];
+  size_t n, i;
+  int j;
+
+  if (!tracing)
+    return;
+
+  n = intr_off_top (top, sizeof top / sizeof *top);
+  printf ("Interrupts off: %lld sections, %lld untracked, longest:\n",
+          off_sections, off_untracked);
+  for (i = 0; i < n; i++)
+    {
+      printf ("  %'"PRId64" ns max, %'"PRId64" ns avg, %lld times:",
+              top[i].max_ns, top[i].total_ns / top[i].count, top[i].count);
+      for (j = 0; j < INTR_OFF_DEPTH && top[i].backtrace[j] != NULL; j++)
+        printf (" %p", top[i].backtrace[j]);
+      printf (".\n");
+    }
+}
+
+/* Opens a section that began at TSC value START at SITE, whose
+   callers' stack frames start at FRAME, if FRAME is nonnull.
+   Only frames on the current stack page are followed, so that a
+   bogus frame pointer is never dereferenced. */
+static void
+off_begin (uint64_t start, void *site, void **frame)
+{
+  const void *stack = pg_round_down (&site);
+  int i;
+
+  off_start = start;
+  off_backtrace[0] = site;
+  for (i = 1; i < INTR_OFF_DEPTH; i++)
+    if (pg_round_down (frame) == stack && pg_round_down (frame + 1) == stack
+        && frame[0] != NULL)
+      {
+        off_backtrace[i] = frame[1];
+        frame = frame[0];
+      }
+    else
+      off_backtrace[i] = NULL;
+}
+
+/* Closes the open section, if it is being timed, and charges it
+   to the place it began. */
+static void
+off_end (void)
+{
+  struct off_site *s;
+  uint64_t length;
+
+  if (off_backtrace[0] == NULL)
+    return;
+  length = clock_cycles () - off_start;
+  off_sections++;
+  s = off_lookup (off_backtrace[0]);
+  if (s != NULL)
+    {
+      s->count++;
+      s->total += length;
+      if (length > s->max)
+        {
+          s->max = length;
+          memcpy (s->backtrace, off_backtrace, sizeof s->backtrace);
+        }
+    }
+  else
+    off_untracked++;
+  off_backtrace[0] = NULL;
+}
+
+/* Returns the entry for SITE in off_sites[], creating it if
+   necessary, or a null pointer if off_sites[] is full. */
+static struct off_site *
+off_lookup (void *site)
+{
+  unsigned h = ((uintptr_t) site * 2654435761u) >> 16;
+  int i;
+
+  for (i = 0; i < OFF_SITES; i++)
+    {
+      struct off_site *s = &off_sites[(h + i) % OFF_SITES];
+      if (s->site == site)
+        return s;
+      else if (s->site == NULL)
+        {
+          s->site = site;
+          return s;
+        }
+    }
+  return NULL;
+}
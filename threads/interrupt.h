@@ -2,6 +2,7 @@
 #define THREADS_INTERRUPT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Interrupts on or off? */
@@ -15,6 +16,7 @@ enum intr_level intr_get_level (void);
 enum intr_level intr_set_level (enum intr_level);
 enum intr_level intr_enable (void);
 enum intr_level intr_disable (void);
+void intr_wait (void);
 
 /* Interrupt stack frame. */
 struct intr_frame
@@ -58,6 +60,7 @@ struct intr_frame
 typedef void intr_handler_func (struct intr_frame *);
 
 void intr_init (void);
+void intr_init_ap (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
@@ -67,4 +70,22 @@ void intr_yield_on_return (void);
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
+/* Interrupts-off latency tracing. */
+#define INTR_OFF_DEPTH 8        /* Return addresses in a backtrace. */
+
+/* Interrupts-off sections begun at one place in the code. */
+struct intr_off_stat
+  {
+    void *site;                         /* Where interrupts went off. */
+    long long count;                    /* Number of sections. */
+    int64_t total_ns;                   /* Total length of the sections. */
+    int64_t max_ns;                     /* Length of the longest. */
+    void *backtrace[INTR_OFF_DEPTH];    /* Call stack of the longest. */
+  };
+
+void intr_trace_start (void);
+size_t intr_off_top (struct intr_off_stat *, size_t cnt);
+void intr_off_reset (void);
+void intr_print_stats (void);
+
 #endif /* threads/interrupt.h */
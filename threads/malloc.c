@@ -7,6 +7,7 @@
 #include <string.h>
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -32,7 +33,26 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of each descriptor, every thread has a "magazine" of
+   up to MAG_ROUNDS blocks that it freed, chained through the
+   blocks themselves.  malloc() takes a block from the running
+   thread's magazine and free() puts one there without taking
+   the descriptor's lock, which only the thread itself ever
+   touches.  Only when the magazine is empty or full does the
+   thread go to the descriptor, which exchanges whole magazines
+   with it: a full magazine from its "depot" of up to DEPOT_MAX
+   of them, or MAG_ROUNDS blocks from its free list, for an empty
+   one; a place in the depot, or else its free list, for a full
+   one.  Blocks in magazines count as in use in their arenas.
+   A thread's magazines are emptied when it exits. */
+
+/* Number of blocks in a full magazine. */
+#define MAG_ROUNDS 8
+
+/* Number of full magazines a descriptor keeps in its depot. */
+#define DEPOT_MAX 4
 
 /* Descriptor. */
 struct desc
@@ -40,7 +60,11 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    struct list depot;          /* Full magazines, by first block. */
+    size_t depot_cnt;           /* Number of magazines in DEPOT. */
     struct lock lock;           /* Lock. */
+    long long mag_hits;         /* malloc() and free() calls that did not */
+    long long mag_misses;       /*   or did need the lock. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -57,15 +81,20 @@ struct arena
 /* Free block. */
 struct block 
   {
-    struct list_elem free_elem; /* Free list element. */
+    struct list_elem free_elem; /* Free list or depot element. */
+    struct block *next;         /* Next block in a magazine. */
   };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[MALLOC_MAG_CLASSES]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *desc_alloc (struct desc *);
+static void desc_free (struct desc *, struct block *);
+static void mag_reload (struct desc *, struct malloc_magazine *);
+static void mag_unload (struct desc *, struct malloc_magazine *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,7 +109,10 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
-      lock_init (&d->lock);
+      list_init (&d->depot);
+      d->depot_cnt = 0;
+      lock_init_named (&d->lock, "malloc");
+      d->mag_hits = d->mag_misses = 0;
     }
 }
 
@@ -89,6 +121,7 @@ malloc_init (void)
 void *
 malloc (size_t size) 
 {
+  struct malloc_magazine *mag;
   struct desc *d;
   struct block *b;
   struct arena *a;
@@ -119,7 +152,65 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
+  /* Take a block from our magazine, refilling it first if it is
+     empty. */
+  mag = &thread_current ()->malloc_mags[d - descs];
+  if (mag->cnt > 0)
+    mag->hits++;
+  else
+    {
+      lock_acquire (&d->lock);
+      mag_reload (d, mag);
+      lock_release (&d->lock);
+      if (mag->cnt == 0)
+        return NULL;
+    }
+  b = mag->top;
+  mag->top = b->next;
+  mag->cnt--;
+  return b;
+}
+
+/* Refills MAG, which must be empty, from descriptor D: with a
+   full magazine from D's depot if there is one, otherwise with
+   up to MAG_ROUNDS blocks from D's free list.  MAG stays empty
+   if memory is not available.  D's lock must be held. */
+static void
+mag_reload (struct desc *d, struct malloc_magazine *mag)
+{
+  ASSERT (mag->cnt == 0);
+
+  d->mag_hits += mag->hits;
+  d->mag_misses++;
+  mag->hits = 0;
+  if (!list_empty (&d->depot))
+    {
+      mag->top = list_entry (list_pop_front (&d->depot), struct block,
+                             free_elem);
+      mag->cnt = MAG_ROUNDS;
+      d->depot_cnt--;
+      return;
+    }
+  mag->top = NULL;
+  while (mag->cnt < MAG_ROUNDS)
+    {
+      struct block *b = desc_alloc (d);
+      if (b == NULL)
+        break;
+      b->next = mag->top;
+      mag->top = b;
+      mag->cnt++;
+    }
+}
+
+/* Takes a block from descriptor D's free list, creating a new
+   arena if it is empty.  Returns a null pointer if memory is not
+   available.  D's lock must be held. */
+static struct block *
+desc_alloc (struct desc *d)
+{
+  struct block *b;
+  struct arena *a;
 
   /* If the free list is empty, create a new arena. */
   if (list_empty (&d->free_list))
@@ -129,10 +220,7 @@ malloc (size_t size)
       /* Allocate a page. */
       a = palloc_get_page (0);
       if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
+        return NULL; 
 
       /* Initialize arena and add its blocks to the free list. */
       a->magic = ARENA_MAGIC;
@@ -149,7 +237,6 @@ malloc (size_t size)
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
   a->free_cnt--;
-  lock_release (&d->lock);
   return b;
 }
 
@@ -227,32 +314,30 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          struct malloc_magazine *mag;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Put the block in our magazine, emptying it first if
+             it is full. */
+          mag = &thread_current ()->malloc_mags[d - descs];
+          if (mag->cnt < MAG_ROUNDS)
+            mag->hits++;
+          else
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              lock_acquire (&d->lock);
+              d->mag_hits += mag->hits;
+              d->mag_misses++;
+              mag->hits = 0;
+              mag_unload (d, mag);
+              lock_release (&d->lock);
             }
-
-          lock_release (&d->lock);
+          b->next = mag->top;
+          mag->top = b;
+          mag->cnt++;
         }
       else
         {
@@ -263,6 +348,86 @@ free (void *p)
     }
 }
 
+/* Empties MAG into descriptor D: into D's depot if MAG is full
+   and the depot has room, otherwise onto D's free list.  D's lock
+   must be held. */
+static void
+mag_unload (struct desc *d, struct malloc_magazine *mag)
+{
+  if (mag->cnt == MAG_ROUNDS && d->depot_cnt < DEPOT_MAX)
+    {
+      list_push_front (&d->depot, &mag->top->free_elem);
+      d->depot_cnt++;
+    }
+  else
+    while (mag->top != NULL)
+      {
+        struct block *b = mag->top;
+        mag->top = b->next;
+        desc_free (d, b);
+      }
+  mag->top = NULL;
+  mag->cnt = 0;
+}
+
+/* Returns block B to descriptor D's free list, and its arena to
+   the page allocator if that leaves it entirely unused.  D's
+   lock must be held. */
+static void
+desc_free (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      palloc_free_page (a);
+    }
+}
+
+/* Returns the blocks in the running thread's magazines to their
+   descriptors.  Called when the thread exits; it must not call
+   malloc() or free() afterward. */
+void
+malloc_thread_exit (void)
+{
+  struct malloc_magazine *mags = thread_current ()->malloc_mags;
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct desc *d = &descs[i];
+
+      lock_acquire (&d->lock);
+      d->mag_hits += mags[i].hits;
+      mags[i].hits = 0;
+      mag_unload (d, &mags[i]);
+      lock_release (&d->lock);
+    }
+}
+
+/* Prints magazine statistics for each descriptor. */
+void
+malloc_print_stats (void)
+{
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    printf ("malloc: %zu-byte blocks: %lld magazine hits, %lld misses\n",
+            descs[i].block_size, descs[i].mag_hits, descs[i].mag_misses);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -4,10 +4,25 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Number of size classes that have magazines, one for each
+   power of 2 from 16 to 1024 bytes. */
+#define MALLOC_MAG_CLASSES 7
+
+/* A thread's magazine of free blocks of one size class.  See
+   malloc.c for details. */
+struct malloc_magazine
+  {
+    struct block *top;          /* Most recently freed block. */
+    unsigned cnt;               /* Number of blocks. */
+    unsigned hits;              /* Hits not yet added to the class. */
+  };
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_thread_exit (void);
+void malloc_print_stats (void);
 
 #endif /* threads/malloc.h */
@@ -1,12 +1,14 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
+#include <list.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/fpu.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,14 +25,58 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Its free pages are
+   grouped into blocks of 2**K pages, for "orders" K from 0 to
+   PALLOC_ORDERS - 1, each aligned to its size relative to the
+   start of the pool, and kept on a free list per order.  A
+   request for N pages takes a block of the smallest order that
+   fits, splitting a larger one if need be, and gives back the
+   pages it does not need.  A freed block is merged with its
+   "buddy", the other half of the block of the next order up,
+   for as long as the buddy is free too.  Both take time
+   proportional to the number of orders, not to the size of the
+   pool or how fragmented it is.
+
+   A free block keeps its free list element in its first page,
+   so the only other memory the allocator needs is one byte per
+   page, which records whether the page begins a free block and
+   of which order.
+
+   Each pool also keeps a reserve of up to ZERO_PAGES_MAX free
+   pages that are already filled with zeros, which the idle
+   thread tops up through palloc_zero_idle() when it has nothing
+   better to do.  Single-page PAL_ZERO requests are served from
+   it first, so that thread creation, page tables and user
+   stacks usually skip the memset().  The reserve is protected by
+   turning interrupts off rather than by the pool's lock, so that
+   the idle thread, which must never sleep, can add to it; it
+   only uses lock_try_acquire() to take pages from the pool.
+   Pages in the reserve count as free, and the reserve is handed
+   back to the pool when an allocation would otherwise fail. */
+
+/* Most zeroed pages to keep in each pool's reserve. */
+#define ZERO_PAGES_MAX 64
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    uint8_t *heads;                     /* Per page, order + 1 if it
+                                           begins a free block, else 0. */
+    struct list free[PALLOC_ORDERS];    /* Free blocks of each order. */
+    size_t free_cnt[PALLOC_ORDERS];     /* Number of blocks in each list. */
+    size_t free_pages;                  /* Number of free pages. */
+
+    /* Zeroed pages.  Protected by turning interrupts off. */
+    struct list zeroed;                 /* Free pages filled with zeros. */
+    size_t zeroed_cnt;                  /* Number of pages in ZEROED. */
+    size_t zeroed_max;                  /* Number of pages to keep there. */
+    long long zero_hits;                /* PAL_ZERO pages from ZEROED. */
+    long long zero_misses;              /* PAL_ZERO pages zeroed on demand. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +85,10 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_range (struct pool *, size_t page_cnt);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void *take_zeroed (struct pool *);
+static bool release_zeroed (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -77,11 +127,20 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (page_cnt == 0)
     return NULL;
 
+  if ((flags & PAL_ZERO) && page_cnt == 1)
+    {
+      pages = take_zeroed (pool);
+      if (pages != NULL)
+        return pages;
+    }
+
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  page_idx = alloc_range (pool, page_cnt);
+  if (page_idx == SIZE_MAX && release_zeroed (pool))
+    page_idx = alloc_range (pool, page_cnt);
   lock_release (&pool->lock);
 
-  if (page_idx != BITMAP_ERROR)
+  if (page_idx != SIZE_MAX)
     pages = pool->base + PGSIZE * page_idx;
   else
     pages = NULL;
@@ -89,7 +148,12 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (pages != NULL) 
     {
       if (flags & PAL_ZERO)
-        memset (pages, 0, PGSIZE * page_cnt);
+        {
+          size_t i;
+
+          for (i = 0; i < page_cnt; i++)
+            fpu_clear_page ((uint8_t *) pages + PGSIZE * i);
+        }
     }
   else 
     {
@@ -132,13 +196,15 @@ palloc_free_multiple (void *pages, size_t page_cnt)
     NOT_REACHED ();
 
   page_idx = pg_no (pages) - pg_no (pool->base);
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  lock_acquire (&pool->lock);
+  free_range (pool, page_idx, page_cnt);
+  lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +214,190 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Takes a page from POOL's zeroed reserve and returns it, or
+   returns a null pointer if the reserve is empty.  Counts a hit
+   or a miss accordingly. */
+static void *
+take_zeroed (struct pool *pool)
+{
+  enum intr_level old_level = intr_disable ();
+  void *page = NULL;
+
+  if (!list_empty (&pool->zeroed))
+    {
+      page = list_pop_front (&pool->zeroed);
+      pool->zeroed_cnt--;
+      pool->zero_hits++;
+    }
+  else
+    pool->zero_misses++;
+  intr_set_level (old_level);
+
+  /* The list element was the only thing in the page. */
+  if (page != NULL)
+    memset (page, 0, sizeof (struct list_elem));
+  return page;
+}
+
+/* Returns all the pages in POOL's zeroed reserve to the pool.
+   Returns true if there were any.  POOL's lock must be held. */
+static bool
+release_zeroed (struct pool *pool)
+{
+  struct list pages;
+  enum intr_level old_level;
+
+  list_init (&pages);
+  old_level = intr_disable ();
+  while (!list_empty (&pool->zeroed))
+    list_push_back (&pages, list_pop_front (&pool->zeroed));
+  pool->zeroed_cnt = 0;
+  intr_set_level (old_level);
+
+  if (list_empty (&pages))
+    return false;
+  while (!list_empty (&pages))
+    {
+      void *page = list_pop_front (&pages);
+      free_range (pool, pg_no (page) - pg_no (pool->base), 1);
+    }
+  return true;
+}
+
+/* Zeroes a free page of POOL and adds it to POOL's reserve, if
+   the reserve is below its watermark and the pool has pages to
+   spare.  Returns true if successful, false if there is nothing
+   to do or POOL's lock is held by another thread. */
+static bool
+zero_page (struct pool *pool)
+{
+  enum intr_level old_level;
+  size_t page_idx = SIZE_MAX;
+  void *page;
+
+  if (pool->zeroed_cnt >= pool->zeroed_max)
+    return false;
+
+  /* Interrupts stay off while we hold the lock, so that no one
+     can see the idle thread as its holder. */
+  old_level = intr_disable ();
+  if (lock_try_acquire (&pool->lock))
+    {
+      if (pool->free_pages > pool->zeroed_max)
+        page_idx = alloc_range (pool, 1);
+      lock_release (&pool->lock);
+    }
+  intr_set_level (old_level);
+  if (page_idx == SIZE_MAX)
+    return false;
+
+  page = pool->base + PGSIZE * page_idx;
+  fpu_clear_page (page);
+
+  old_level = intr_disable ();
+  list_push_front (&pool->zeroed, page);
+  pool->zeroed_cnt++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Zeroes one free page for the reserve of a pool that is short
+   of them.  Returns true if it did, false if there is nothing to
+   do right now.  Called by the idle thread, with interrupts on;
+   never sleeps. */
+bool
+palloc_zero_idle (void)
+{
+  return zero_page (&kernel_pool) || zero_page (&user_pool);
+}
+
+/* Stores statistics about the free pages in the pool that FLAGS
+   selects, as in palloc_get_multiple(), into *STATS. */
+void
+palloc_get_stats (enum palloc_flags flags, struct palloc_stats *stats)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  int order;
+
+  lock_acquire (&pool->lock);
+  stats->page_cnt = pool->page_cnt;
+  stats->free_pages = pool->free_pages;
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    stats->free_blocks[order] = pool->free_cnt[order];
+  old_level = intr_disable ();
+  stats->zeroed_pages = pool->zeroed_cnt;
+  stats->zero_hits = pool->zero_hits;
+  stats->zero_misses = pool->zero_misses;
+  intr_set_level (old_level);
+  lock_release (&pool->lock);
+  stats->free_pages += stats->zeroed_pages;
+}
+
+/* Prints the number of free pages in POOL, named NAME, and of
+   free blocks of each order up to the largest one it has. */
+static void
+print_pool_stats (struct pool *pool, const char *name)
+{
+  int order, top;
+
+  lock_acquire (&pool->lock);
+  printf ("Page allocator: %s: %zu of %zu pages free, blocks by order:",
+          name, pool->free_pages, pool->page_cnt);
+  for (top = PALLOC_ORDERS - 1; top > 0 && pool->free_cnt[top] == 0; top--)
+    continue;
+  for (order = 0; order <= top; order++)
+    printf (" %zu", pool->free_cnt[order]);
+  printf ("\n");
+  printf ("Page allocator: %s: %zu zeroed pages, %lld zeroed page hits, "
+          "%lld misses\n",
+          name, pool->zeroed_cnt, pool->zero_hits, pool->zero_misses);
+  lock_release (&pool->lock);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool, "kernel pool");
+  print_pool_stats (&user_pool, "user pool");
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  /* We'll put the pool's array of free block heads at its base.
+     Calculate the space needed for it and subtract it from the
+     pool's size. */
+  size_t heads_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+
+  if (heads_pages > page_cnt)
+    PANIC ("Not enough memory in %s for free block map.", name);
+  page_cnt -= heads_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  lock_init_named (&p->lock, name);
+  p->heads = base;
+  memset (p->heads, 0, page_cnt);
+  p->base = base + heads_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    {
+      list_init (&p->free[order]);
+      p->free_cnt[order] = 0;
+    }
+  p->free_pages = 0;
+  free_range (p, 0, page_cnt);
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->zeroed_max = page_cnt / 16 < ZERO_PAGES_MAX ? page_cnt / 16
+                                                  : ZERO_PAGES_MAX;
+  p->zero_hits = p->zero_misses = 0;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +407,118 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the free list element kept in page PAGE_IDX of POOL. */
+static inline struct list_elem *
+block_elem (struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Puts the free block of order ORDER at PAGE_IDX in POOL on its
+   free list. */
+static void
+insert_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->heads[page_idx] = order + 1;
+  list_push_front (&pool->free[order], block_elem (pool, page_idx));
+  pool->free_cnt[order]++;
+}
+
+/* Takes the free block of order ORDER at PAGE_IDX in POOL off its
+   free list. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->heads[page_idx] == order + 1);
+
+  pool->heads[page_idx] = 0;
+  list_remove (block_elem (pool, page_idx));
+  pool->free_cnt[order]--;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or SIZE_MAX if there is no free block
+   big enough.  POOL's lock must be held. */
+static size_t
+alloc_range (struct pool *pool, size_t page_cnt)
+{
+  size_t page_idx;
+  int order, k;
+
+  /* Find the smallest order that fits, then the smallest free
+     block of at least that order. */
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    if (((size_t) 1 << order) >= page_cnt)
+      break;
+  for (k = order; k < PALLOC_ORDERS; k++)
+    if (!list_empty (&pool->free[k]))
+      break;
+  if (k >= PALLOC_ORDERS)
+    return SIZE_MAX;
+
+  page_idx = (pg_no (list_front (&pool->free[k])) - pg_no (pool->base));
+  remove_block (pool, page_idx, k);
+  pool->free_pages -= (size_t) 1 << k;
+
+  /* Split it down to ORDER, freeing the upper halves. */
+  while (k > order)
+    {
+      k--;
+      insert_block (pool, page_idx + ((size_t) 1 << k), k);
+      pool->free_pages += (size_t) 1 << k;
+    }
+
+  /* Give back the pages beyond PAGE_CNT. */
+  if (page_cnt < ((size_t) 1 << order))
+    free_range (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+
+  return page_idx;
+}
+
+/* Frees the block of order ORDER at PAGE_IDX in POOL, merging it
+   with its buddy for as long as the buddy is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->heads[page_idx] == 0);
+
+  pool->free_pages += (size_t) 1 << order;
+  while (order + 1 < PALLOC_ORDERS)
+    {
+      size_t size = (size_t) 1 << order;
+      size_t buddy = page_idx ^ size;
+
+      if (buddy + size > pool->page_cnt
+          || pool->heads[buddy] != order + 1)
+        break;
+      remove_block (pool, buddy, order);
+      if (buddy < page_idx)
+        page_idx = buddy;
+      order++;
+    }
+  insert_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as
+   blocks as large as their alignment allows. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order + 1 < PALLOC_ORDERS
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
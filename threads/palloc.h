@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,10 +12,28 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* Number of block sizes in the buddy allocator, which hands out
+   blocks of 1, 2, 4, ..., 2**(PALLOC_ORDERS - 1) pages. */
+#define PALLOC_ORDERS 20
+
+/* Free memory in a pool. */
+struct palloc_stats
+  {
+    size_t page_cnt;                    /* Pages in the pool. */
+    size_t free_pages;                  /* Free pages. */
+    size_t free_blocks[PALLOC_ORDERS];  /* Free blocks of each order. */
+    size_t zeroed_pages;                /* Free pages already zeroed. */
+    long long zero_hits;                /* PAL_ZERO pages from the reserve. */
+    long long zero_misses;              /* PAL_ZERO pages zeroed on demand. */
+  };
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_zero_idle (void);
+void palloc_get_stats (enum palloc_flags, struct palloc_stats *);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,313 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Sampling profiler.
+
+   Once enabled by the "-profile" kernel option, every timer tick
+   on every CPU records the address of the instruction it
+   interrupted, both in a global histogram and in a histogram per
+   thread.  With "-profile=chains", it also records the call chain
+   leading to that instruction, found by walking the saved frame
+   pointers just as debug_backtrace() does.
+
+   The histograms are fixed-size open-addressing hash tables,
+   allocated when the profiler is enabled, so that sampling never
+   allocates memory.  A sample that finds no room is dropped and
+   counted.  All of them are protected by the interrupt lock,
+   which the timer interrupt handlers hold.
+
+   At shutdown the results are printed, one record per line:
+
+        profile: pc ADDR COUNT
+        profile: thread TID NAME ADDR COUNT
+        profile: chain COUNT ADDR...
+
+   in the same format as the addresses in a backtrace, so that a
+   host script can symbolize them with `addr2line -f -e kernel.o'
+   and aggregate them by function. */
+
+/* Histogram of interrupted instructions. */
+struct pc_count
+  {
+    uintptr_t pc;               /* Interrupted instruction, 0 if free. */
+    unsigned count;             /* Samples. */
+  };
+
+/* Histogram of interrupted instructions, per thread. */
+struct thread_pc_count
+  {
+    uintptr_t pc;               /* Interrupted instruction, 0 if free. */
+    tid_t tid;                  /* Interrupted thread. */
+    unsigned count;             /* Samples. */
+  };
+
+/* Threads that were sampled, to name them in the output. */
+struct sampled_thread
+  {
+    tid_t tid;                  /* Thread identifier, 0 if free. */
+    char name[16];              /* Thread name when first sampled. */
+  };
+
+/* Histogram of call chains.  PCS[0] is the interrupted
+   instruction, the rest are return addresses, outermost last. */
+#define CHAIN_DEPTH 8
+struct chain_count
+  {
+    uintptr_t pcs[CHAIN_DEPTH]; /* Call chain, 0-terminated if short. */
+    unsigned count;             /* Samples. */
+  };
+
+/* Table sizes, each a power of 2. */
+#define PC_SLOTS 2048
+#define THREAD_PC_SLOTS 2048
+#define THREAD_SLOTS 128
+#define CHAIN_SLOTS 1024
+
+/* Slots to probe before dropping a sample. */
+#define MAX_PROBES 16
+
+static bool enabled;                    /* Sampling? */
+static bool chains;                     /* Recording call chains? */
+static struct pc_count *pcs;
+static struct thread_pc_count *thread_pcs;
+static struct sampled_thread *threads;
+static struct chain_count *chain_counts;
+static size_t page_cnt;                 /* Pages holding the tables. */
+static long long samples;               /* Samples taken. */
+static long long dropped;               /* Samples that found no slot. */
+
+static unsigned hash_word (uintptr_t);
+static void *carve (uint8_t **, size_t size);
+static bool record_pc (uintptr_t pc);
+static bool record_thread_pc (const struct thread *, uintptr_t pc);
+static bool record_chain (const struct intr_frame *);
+static bool frame_on_stack (void **frame, const void *stack);
+
+/* Allocates the profiler's tables and starts sampling, with call
+   chains if CALL_CHAINS is true.  Must be called after
+   palloc_init(). */
+void
+profile_init (bool call_chains)
+{
+  size_t size = (PC_SLOTS * sizeof *pcs
+                 + THREAD_PC_SLOTS * sizeof *thread_pcs
+                 + THREAD_SLOTS * sizeof *threads
+                 + (call_chains ? CHAIN_SLOTS * sizeof *chain_counts : 0));
+  uint8_t *p;
+
+  page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  p = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, page_cnt);
+  pcs = carve (&p, PC_SLOTS * sizeof *pcs);
+  thread_pcs = carve (&p, THREAD_PC_SLOTS * sizeof *thread_pcs);
+  threads = carve (&p, THREAD_SLOTS * sizeof *threads);
+  if (call_chains)
+    chain_counts = carve (&p, CHAIN_SLOTS * sizeof *chain_counts);
+  chains = call_chains;
+  enabled = true;
+}
+
+/* Records a sample of the code interrupted with frame F.  Called
+   from the timer interrupt handlers. */
+void
+profile_sample (const struct intr_frame *f)
+{
+  uintptr_t pc = (uintptr_t) f->eip;
+  bool ok;
+
+  if (!enabled)
+    return;
+  ASSERT (intr_context ());
+
+  samples++;
+  ok = record_pc (pc);
+  ok = record_thread_pc (thread_current (), pc) && ok;
+  if (chains)
+    ok = record_chain (f) && ok;
+  if (!ok)
+    dropped++;
+}
+
+/* Prints the profile. */
+void
+profile_print_stats (void)
+{
+  enum intr_level old_level;
+  size_t i;
+
+  if (!enabled)
+    return;
+
+  /* Stop sampling while the tables are read. */
+  old_level = intr_disable ();
+  enabled = false;
+  intr_set_level (old_level);
+
+  printf ("Profile: %lld samples, %lld dropped, %zu pages\n",
+          samples, dropped, page_cnt);
+  for (i = 0; i < PC_SLOTS; i++)
+    if (pcs[i].pc != 0)
+      printf ("profile: pc %p %u\n", (void *) pcs[i].pc, pcs[i].count);
+  for (i = 0; i < THREAD_PC_SLOTS; i++)
+    if (thread_pcs[i].pc != 0)
+      {
+        const struct thread_pc_count *tpc = &thread_pcs[i];
+        const char *name = "?";
+        size_t j;
+
+        for (j = 0; j < THREAD_SLOTS; j++)
+          if (threads[j].tid == tpc->tid)
+            {
+              name = threads[j].name;
+              break;
+            }
+        printf ("profile: thread %d %s %p %u\n",
+                tpc->tid, name, (void *) tpc->pc, tpc->count);
+      }
+  if (chains)
+    for (i = 0; i < CHAIN_SLOTS; i++)
+      if (chain_counts[i].count != 0)
+        {
+          size_t j;
+
+          printf ("profile: chain %u", chain_counts[i].count);
+          for (j = 0; j < CHAIN_DEPTH && chain_counts[i].pcs[j] != 0; j++)
+            printf (" %p", (void *) chain_counts[i].pcs[j]);
+          printf ("\n");
+        }
+}
+
+/* Returns a hash of word W, with all of W's bits mixed into the
+   low bits that select a slot. */
+static unsigned
+hash_word (uintptr_t w)
+{
+  uint32_t h = w;
+
+  h = (h ^ (h >> 16)) * 0x45d9f3b;
+  h = (h ^ (h >> 16)) * 0x45d9f3b;
+  return h ^ (h >> 16);
+}
+
+/* Returns the next SIZE bytes at *P and advances *P past them. */
+static void *
+carve (uint8_t **p, size_t size)
+{
+  void *block = *p;
+  *p += size;
+  return block;
+}
+
+/* Counts a sample of PC in the global histogram.  Returns false
+   if there was no room for it. */
+static bool
+record_pc (uintptr_t pc)
+{
+  unsigned h = hash_word (pc);
+  int i;
+
+  for (i = 0; i < MAX_PROBES; i++)
+    {
+      struct pc_count *c = &pcs[(h + i) % PC_SLOTS];
+      if (c->pc == pc || c->pc == 0)
+        {
+          c->pc = pc;
+          c->count++;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Counts a sample of PC in thread T's histogram, and remembers
+   T's name.  Returns false if there was no room for it. */
+static bool
+record_thread_pc (const struct thread *t, uintptr_t pc)
+{
+  unsigned h = hash_word (pc ^ ((uintptr_t) t->tid << 24));
+  bool ok = false;
+  int i;
+
+  for (i = 0; i < MAX_PROBES; i++)
+    {
+      struct thread_pc_count *c = &thread_pcs[(h + i) % THREAD_PC_SLOTS];
+      if ((c->pc == pc && c->tid == t->tid) || c->pc == 0)
+        {
+          c->pc = pc;
+          c->tid = t->tid;
+          c->count++;
+          ok = true;
+          break;
+        }
+    }
+
+  h = hash_word (t->tid);
+  for (i = 0; i < MAX_PROBES; i++)
+    {
+      struct sampled_thread *st = &threads[(h + i) % THREAD_SLOTS];
+      if (st->tid == t->tid)
+        break;
+      else if (st->tid == 0)
+        {
+          st->tid = t->tid;
+          strlcpy (st->name, t->name, sizeof st->name);
+          break;
+        }
+    }
+  return ok;
+}
+
+/* Counts a sample of the call chain interrupted with frame F.
+   Only frames on the interrupted kernel stack are followed, so a
+   corrupt or user-mode frame pointer is never dereferenced.
+   Returns false if there was no room for the chain. */
+static bool
+record_chain (const struct intr_frame *f)
+{
+  uintptr_t chain[CHAIN_DEPTH];
+  const void *stack = pg_round_down (f);
+  void **frame = f->frame_pointer;
+  unsigned h;
+  int depth, i;
+
+  memset (chain, 0, sizeof chain);
+  chain[0] = (uintptr_t) f->eip;
+  h = hash_word (chain[0]);
+  if (is_kernel_vaddr (f->eip))
+    for (depth = 1;
+         depth < CHAIN_DEPTH && frame_on_stack (frame, stack)
+           && frame[0] != NULL;
+         depth++, frame = frame[0])
+      {
+        chain[depth] = (uintptr_t) frame[1];
+        h = hash_word (h ^ chain[depth]);
+      }
+
+  for (i = 0; i < MAX_PROBES; i++)
+    {
+      struct chain_count *c = &chain_counts[(h + i) % CHAIN_SLOTS];
+      if (c->count == 0 || !memcmp (c->pcs, chain, sizeof chain))
+        {
+          memcpy (c->pcs, chain, sizeof chain);
+          c->count++;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Returns true if both words of FRAME, a saved frame pointer and
+   a return address, lie within the stack page STACK. */
+static bool
+frame_on_stack (void **frame, const void *stack)
+{
+  return (pg_round_down (frame) == stack
+          && pg_round_down (frame + 1) == stack);
+}
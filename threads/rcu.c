@@ -0,0 +1,228 @@
+#include "threads/rcu.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Quiescent-state-based RCU.
+
+   A CPU in a read-side critical section neither switches threads
+   nor, while it is in one, reports the timer ticks it takes as
+   quiescent states.  So once every CPU has switched threads or
+   taken a tick outside any read-side critical section, no reader
+   that was running when the grace period began is left.  A CPU
+   that is running its idle thread when a grace period begins is
+   not in a read-side critical section and need not report at
+   all.
+
+   Grace periods are run by the "rcu" kernel thread, one batch
+   of callbacks at a time.  It starts a grace period by bumping
+   gp_seq and counting the CPUs that must report; each CPU
+   reports once per grace period, by setting its rcu_seq to
+   gp_seq.  The last one wakes the thread, which then runs the
+   batch's callbacks.
+
+   All of this state is protected by the interrupt lock. */
+
+/* Callbacks waiting for the next grace period. */
+static struct list rcu_pending = LIST_INITIALIZER (rcu_pending);
+
+/* Grace periods. */
+static unsigned gp_seq;         /* Number of the latest grace period. */
+static int gp_waiting;          /* CPUs yet to report in it. */
+
+static struct thread *rcu_thread;
+static bool rcu_waiting;        /* rcu_thread blocked waiting? */
+
+/* Statistics. */
+static long long gp_cnt;        /* Grace periods completed. */
+static long long callback_cnt;  /* Callbacks run. */
+
+static thread_func rcu_run;
+
+/* Initializes RCU and starts the thread that runs grace periods
+   and callbacks.  Callbacks queued before then are run once it
+   starts. */
+void
+rcu_init (void)
+{
+  thread_create ("rcu", PRI_MAX, rcu_run, NULL);
+}
+
+/* Enters a read-side critical section.  Until the matching
+   rcu_read_unlock(), elements that writers unlink from the data
+   structures read under RCU will not be reclaimed. */
+void
+rcu_read_lock (void)
+{
+  thread_current ()->rcu_nesting++;
+  barrier ();
+}
+
+/* Leaves a read-side critical section.  Carries out a preemption
+   that was requested while the thread was in it. */
+void
+rcu_read_unlock (void)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (cur->rcu_nesting > 0);
+
+  barrier ();
+  if (--cur->rcu_nesting == 0 && cur->rcu_preempt_pending)
+    {
+      cur->rcu_preempt_pending = false;
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_preempt ();
+    }
+}
+
+/* Arranges for FUNC to be called with HEAD, from a kernel thread,
+   after a grace period has elapsed, that is, once every reader
+   that might still see the structure that HEAD is embedded in is
+   done.
+
+   This function does not sleep, so it may be called within an
+   interrupt handler or with interrupts off. */
+void
+call_rcu (struct rcu_head *head, void (*func) (struct rcu_head *))
+{
+  enum intr_level old_level;
+
+  ASSERT (head != NULL);
+  ASSERT (func != NULL);
+
+  head->func = func;
+  old_level = intr_disable ();
+  list_push_back (&rcu_pending, &head->elem);
+  if (rcu_waiting && gp_waiting == 0)
+    {
+      rcu_waiting = false;
+      thread_unblock (rcu_thread);
+    }
+  intr_set_level (old_level);
+}
+
+/* A grace period being waited for by synchronize_rcu(). */
+struct rcu_sync
+  {
+    struct rcu_head head;
+    struct semaphore done;
+  };
+
+/* Wakes up the thread waiting for a grace period in
+   synchronize_rcu(). */
+static void
+rcu_sync_done (struct rcu_head *head)
+{
+  sema_up (&rcu_entry (head, struct rcu_sync, head)->done);
+}
+
+/* Waits until a grace period has elapsed, so that every reader
+   that was in a read-side critical section when this function
+   was called has left it.
+
+   This function sleeps, so it must not be called within an
+   interrupt handler or a read-side critical section. */
+void
+synchronize_rcu (void)
+{
+  struct rcu_sync sync;
+
+  ASSERT (!intr_context ());
+  ASSERT (thread_current ()->rcu_nesting == 0);
+
+  sema_init (&sync.done, 0);
+  call_rcu (&sync.head, rcu_sync_done);
+  sema_down (&sync.done);
+}
+
+/* Reports a quiescent state of CPU, the current CPU, which has
+   just switched threads or taken a timer tick outside any
+   read-side critical section.  Interrupts must be off. */
+void
+rcu_quiescent (struct cpu *cpu)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (cpu->rcu_seq != gp_seq)
+    {
+      cpu->rcu_seq = gp_seq;
+      if (--gp_waiting == 0 && rcu_waiting)
+        {
+          rcu_waiting = false;
+          thread_unblock (rcu_thread);
+        }
+    }
+}
+
+/* Starts a new grace period.  Interrupts must be off. */
+static void
+start_grace_period (void)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (gp_waiting == 0);
+
+  gp_seq++;
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *cpu = &cpus[i];
+
+      if (!cpu->started || cpu->current == cpu->idle_thread)
+        cpu->rcu_seq = gp_seq;
+      else
+        gp_waiting++;
+    }
+}
+
+/* The "rcu" thread.  Waits for callbacks, takes all of them as a
+   batch, waits out a grace period for the batch and runs it. */
+static void
+rcu_run (void *aux UNUSED)
+{
+  struct list batch;
+
+  rcu_thread = thread_current ();
+  list_init (&batch);
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+
+      while (list_empty (&rcu_pending))
+        {
+          rcu_waiting = true;
+          thread_block ();
+        }
+      while (!list_empty (&rcu_pending))
+        list_push_back (&batch, list_pop_front (&rcu_pending));
+      start_grace_period ();
+      while (gp_waiting > 0)
+        {
+          rcu_waiting = true;
+          thread_block ();
+        }
+      gp_cnt++;
+      intr_set_level (old_level);
+
+      while (!list_empty (&batch))
+        {
+          struct rcu_head *head = list_entry (list_pop_front (&batch),
+                                              struct rcu_head, elem);
+          head->func (head);
+          callback_cnt++;
+        }
+    }
+}
+
+/* Prints RCU statistics. */
+void
+rcu_print_stats (void)
+{
+  printf ("RCU: %lld grace periods, %lld callbacks\n", gp_cnt, callback_cnt);
+}
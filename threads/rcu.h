@@ -0,0 +1,85 @@
+#ifndef THREADS_RCU_H
+#define THREADS_RCU_H
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Read-copy update.
+
+   RCU lets readers traverse a shared data structure, typically a
+   list, without locks and without turning interrupts off, while
+   writers unlink elements and defer freeing them until every
+   reader that could still see them is done.
+
+   Readers bracket their accesses with rcu_read_lock() and
+   rcu_read_unlock().  A read-side critical section may nest and
+   may be entered from an interrupt handler, but it must not
+   sleep or yield.  A thread is not preempted while it is in one;
+   it is preempted when it leaves instead.
+
+   Writers must still be serialized among themselves, by a lock
+   or by turning interrupts off.  They publish new list elements
+   with rcu_list_insert() and friends, which initialize an element
+   fully before linking it in, and unlink elements with plain
+   list_remove(), which leaves the removed element's links intact
+   for readers standing on it.  Once an element is unlinked,
+   call_rcu() runs a function to free it after a grace period,
+   that is, after every CPU has gone through a quiescent state:
+   a context switch, or a timer tick outside any read-side
+   critical section.  synchronize_rcu() waits for a grace period
+   instead. */
+
+/* Deferred call, embedded in the structure to be reclaimed. */
+struct rcu_head
+  {
+    struct list_elem elem;              /* Element in a callback list. */
+    void (*func) (struct rcu_head *);   /* Function to call. */
+  };
+
+/* Converts pointer to rcu_head RCU_HEAD into a pointer to the
+   structure that RCU_HEAD is embedded inside.  Supply the name
+   of the outer structure STRUCT and the member name MEMBER of
+   the rcu_head. */
+#define rcu_entry(RCU_HEAD, STRUCT, MEMBER)                     \
+        ((STRUCT *) ((uint8_t *) (RCU_HEAD)                     \
+                     - offsetof (STRUCT, MEMBER)))
+
+struct cpu;
+
+void rcu_init (void);
+void rcu_read_lock (void);
+void rcu_read_unlock (void);
+void call_rcu (struct rcu_head *, void (*func) (struct rcu_head *));
+void synchronize_rcu (void);
+void rcu_quiescent (struct cpu *);
+void rcu_print_stats (void);
+
+/* Inserts ELEM just before BEFORE, publishing it to readers
+   traversing the list under rcu_read_lock() once it is fully
+   linked.  BEFORE may be an interior element or a tail. */
+static inline void
+rcu_list_insert (struct list_elem *before, struct list_elem *elem)
+{
+  elem->prev = before->prev;
+  elem->next = before;
+  asm volatile ("" : : : "memory");
+  before->prev->next = elem;
+  before->prev = elem;
+}
+
+/* Inserts ELEM at the beginning of LIST, for RCU readers. */
+static inline void
+rcu_list_push_front (struct list *list, struct list_elem *elem)
+{
+  rcu_list_insert (list_begin (list), elem);
+}
+
+/* Inserts ELEM at the end of LIST, for RCU readers. */
+static inline void
+rcu_list_push_back (struct list *list, struct list_elem *elem)
+{
+  rcu_list_insert (list_end (list), elem);
+}
+
+#endif /* threads/rcu.h */
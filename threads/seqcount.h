@@ -0,0 +1,86 @@
+#ifndef THREADS_SEQCOUNT_H
+#define THREADS_SEQCOUNT_H
+
+#include <stdbool.h>
+
+/* Sequence counter.
+
+   A sequence counter lets readers take a consistent snapshot of
+   a few words of data, such as a 64-bit counter on our 32-bit
+   CPU, without writing anything and without turning interrupts
+   off.  The writer makes the count odd while it changes the data
+   and even again when it is done.  A reader notes the count
+   before reading the data and retries if the count was odd or
+   has changed since:
+
+        unsigned seq;
+        do
+          {
+            seq = seqcount_read_begin (&sc);
+            ...read the data...
+          }
+        while (seqcount_read_retry (&sc, seq));
+
+   Writers must be serialized by other means, usually by turning
+   interrupts off, and a reader must never interrupt a writer on
+   the same CPU, or it will spin forever.
+
+   x86 does not reorder loads with other loads or stores with
+   other stores, so compiler barriers order the accesses well
+   enough. */
+struct seqcount
+  {
+    volatile unsigned sequence; /* Odd while a write is in progress. */
+  };
+
+/* Initializer for a sequence counter. */
+#define SEQCOUNT_INITIALIZER { 0 }
+
+/* Initializes SC. */
+static inline void
+seqcount_init (struct seqcount *sc)
+{
+  sc->sequence = 0;
+}
+
+/* Begins a read of the data protected by SC, waiting for a write
+   in progress to finish first.  Returns the value to pass to
+   seqcount_read_retry(). */
+static inline unsigned
+seqcount_read_begin (const struct seqcount *sc)
+{
+  unsigned seq;
+
+  while ((seq = sc->sequence) & 1)
+    asm volatile ("pause" : : : "memory");
+  asm volatile ("" : : : "memory");
+  return seq;
+}
+
+/* Returns true if the data read since seqcount_read_begin()
+   returned SEQ may be inconsistent, in which case the reader must
+   start over. */
+static inline bool
+seqcount_read_retry (const struct seqcount *sc, unsigned seq)
+{
+  asm volatile ("" : : : "memory");
+  return sc->sequence != seq;
+}
+
+/* Begins a change to the data protected by SC. */
+static inline void
+seqcount_write_begin (struct seqcount *sc)
+{
+  sc->sequence++;
+  asm volatile ("" : : : "memory");
+}
+
+/* Ends a change to the data protected by SC. */
+static inline void
+seqcount_write_end (struct seqcount *sc)
+{
+  asm volatile ("" : : : "memory");
+  sc->sequence++;
+}
+
+#endif /* threads/seqcount.h */
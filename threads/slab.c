@@ -0,0 +1,301 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   malloc() rounds every request up to a power of 2, which wastes
+   up to half of each block for objects whose size is just past
+   one.  A slab cache instead hands out objects of exactly one
+   size, so it suits types that are allocated and freed often,
+   such as the file system's inodes and open files.
+
+   Each slab is one page from the page allocator.  It begins with
+   a struct slab header, followed by an array that chains the
+   free objects by index, followed by the objects themselves.
+   Keeping the free chain outside the objects means that a freed
+   object keeps whatever state the cache's constructor, if any,
+   gave it: the constructor only runs when a slab is created, and
+   a caller that frees an object must return it to that state.
+
+   The space left over at the end of a slab, if any, is used to
+   "color" the slabs: each new slab starts its objects a
+   different multiple of COLOR_ALIGN bytes into the page, so that
+   the objects at the same index in different slabs do not all
+   compete for the same cache sets.
+
+   Slabs are kept on one of three lists in their cache, by
+   whether all, some or none of their objects are in use.
+   Objects are allocated from partly used slabs first, to let the
+   other slabs empty out.  A cache keeps up to EMPTY_MAX empty
+   slabs around and returns the rest to the page allocator. */
+
+/* Objects are aligned to this many bytes. */
+#define OBJ_ALIGN 8
+
+/* Slab colors are this many bytes apart, the size of a cache
+   line. */
+#define COLOR_ALIGN 64
+
+/* Number of empty slabs a cache keeps. */
+#define EMPTY_MAX 1
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* No next free object. */
+#define FREE_END UINT16_MAX
+
+/* A slab, at the beginning of its page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    uint8_t *objs;              /* First object. */
+    size_t in_use;              /* Number of objects in use. */
+    uint16_t free;              /* Index of the first free object. */
+    uint16_t next[];            /* Index of the next free object. */
+  };
+
+/* All slab caches. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+static struct lock all_caches_lock;
+
+static struct slab *slab_create (struct slab_cache *);
+static struct slab *obj_to_slab (struct slab_cache *, void *);
+
+/* Initializes the slab allocator. */
+void
+slab_init (void)
+{
+  lock_init_named (&all_caches_lock, "slab caches");
+}
+
+/* Initializes CACHE to allocate objects of SIZE bytes, naming it
+   NAME for statistics.  If CTOR is nonnull, it is called on each
+   object when its slab is created.  SIZE must not be so large
+   that a page cannot hold at least one object. */
+void
+slab_cache_init (struct slab_cache *cache, const char *name, size_t size,
+                 void (*ctor) (void *))
+{
+  size_t avail, left;
+
+  ASSERT (cache != NULL);
+  ASSERT (size > 0);
+
+  cache->name = name;
+  cache->obj_size = ROUND_UP (size, OBJ_ALIGN);
+  avail = PGSIZE - ROUND_UP (sizeof (struct slab), OBJ_ALIGN);
+  cache->objs_per_slab = avail / (cache->obj_size + sizeof (uint16_t));
+  ASSERT (cache->objs_per_slab > 0);
+  ASSERT (cache->objs_per_slab < FREE_END);
+  left = (PGSIZE - ROUND_UP (sizeof (struct slab)
+                             + cache->objs_per_slab * sizeof (uint16_t),
+                             OBJ_ALIGN)
+          - cache->objs_per_slab * cache->obj_size);
+  cache->color_cnt = left / COLOR_ALIGN + 1;
+  cache->next_color = 0;
+  cache->ctor = ctor;
+  lock_init_named (&cache->lock, name);
+  list_init (&cache->partial);
+  list_init (&cache->full);
+  list_init (&cache->empty);
+  cache->empty_cnt = 0;
+  cache->slab_cnt = 0;
+  cache->active = 0;
+
+  lock_acquire (&all_caches_lock);
+  list_push_back (&all_caches, &cache->elem);
+  lock_release (&all_caches_lock);
+}
+
+/* Destroys CACHE, returning its slabs to the page allocator.  No
+   object allocated from CACHE may still be in use. */
+void
+slab_cache_destroy (struct slab_cache *cache)
+{
+  ASSERT (cache != NULL);
+  ASSERT (cache->active == 0);
+  ASSERT (list_empty (&cache->partial) && list_empty (&cache->full));
+
+  lock_acquire (&all_caches_lock);
+  list_remove (&cache->elem);
+  lock_release (&all_caches_lock);
+
+  while (!list_empty (&cache->empty))
+    palloc_free_page (list_entry (list_pop_front (&cache->empty),
+                                  struct slab, elem));
+  cache->empty_cnt = 0;
+  cache->slab_cnt = 0;
+}
+
+/* Obtains and returns an object from CACHE, or a null pointer if
+   memory is not available. */
+void *
+slab_alloc (struct slab_cache *cache) 
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (cache != NULL);
+
+  lock_acquire (&cache->lock);
+  if (!list_empty (&cache->partial))
+    s = list_entry (list_front (&cache->partial), struct slab, elem);
+  else if (!list_empty (&cache->empty))
+    {
+      s = list_entry (list_pop_front (&cache->empty), struct slab, elem);
+      cache->empty_cnt--;
+      list_push_front (&cache->partial, &s->elem);
+    }
+  else
+    {
+      s = slab_create (cache);
+      if (s == NULL)
+        {
+          lock_release (&cache->lock);
+          return NULL;
+        }
+      list_push_front (&cache->partial, &s->elem);
+    }
+
+  ASSERT (s->free != FREE_END);
+  obj = s->objs + s->free * cache->obj_size;
+  s->free = s->next[s->free];
+  if (++s->in_use == cache->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_front (&cache->full, &s->elem);
+    }
+  cache->active++;
+  lock_release (&cache->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from CACHE, to
+   CACHE.  If CACHE has a constructor, OBJ must be in the state
+   the constructor leaves objects in. */
+void
+slab_free (struct slab_cache *cache, void *obj) 
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (cache, obj);
+  idx = ((uint8_t *) obj - s->objs) / cache->obj_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it must keep its constructed state. */
+  if (cache->ctor == NULL)
+    memset (obj, 0xcc, cache->obj_size);
+#endif
+
+  lock_acquire (&cache->lock);
+  if (s->in_use-- == cache->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_front (&cache->partial, &s->elem);
+    }
+  s->next[idx] = s->free;
+  s->free = idx;
+  cache->active--;
+
+  if (s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (cache->empty_cnt < EMPTY_MAX)
+        {
+          list_push_front (&cache->empty, &s->elem);
+          cache->empty_cnt++;
+        }
+      else
+        {
+          s->magic = 0;
+          cache->slab_cnt--;
+          palloc_free_page (s);
+        }
+    }
+  lock_release (&cache->lock);
+}
+
+/* Prints statistics for each slab cache. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  lock_acquire (&all_caches_lock);
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct slab_cache *cache = list_entry (e, struct slab_cache, elem);
+
+      lock_acquire (&cache->lock);
+      printf ("Slab: %s: %zu-byte objects, %zu of %zu in use, %zu slabs\n",
+              cache->name, cache->obj_size, cache->active,
+              cache->slab_cnt * cache->objs_per_slab, cache->slab_cnt);
+      lock_release (&cache->lock);
+    }
+  lock_release (&all_caches_lock);
+}
+
+/* Creates a new slab for CACHE, with all its objects free and
+   constructed.  Returns a null pointer if memory is not
+   available.  CACHE's lock must be held. */
+static struct slab *
+slab_create (struct slab_cache *cache)
+{
+  struct slab *s;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = cache;
+  s->objs = ((uint8_t *) s
+             + ROUND_UP (sizeof *s + cache->objs_per_slab * sizeof *s->next,
+                         OBJ_ALIGN)
+             + cache->next_color * COLOR_ALIGN);
+  s->in_use = 0;
+  s->free = 0;
+  for (i = 0; i < cache->objs_per_slab; i++)
+    s->next[i] = i + 1 < cache->objs_per_slab ? i + 1 : FREE_END;
+  if (cache->ctor != NULL)
+    for (i = 0; i < cache->objs_per_slab; i++)
+      cache->ctor (s->objs + i * cache->obj_size);
+
+  cache->next_color = (cache->next_color + 1) % cache->color_cnt;
+  cache->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab that OBJ, allocated from CACHE, is inside. */
+static struct slab *
+obj_to_slab (struct slab_cache *cache UNUSED, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == cache);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT ((uint8_t *) obj >= s->objs);
+  ASSERT (((uint8_t *) obj - s->objs) % cache->obj_size == 0);
+
+  return s;
+}
@@ -0,0 +1,36 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Cache of objects of one type, allocated from slabs.  See
+   slab.c for details. */
+struct slab_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size of an object, rounded up. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t color_cnt;           /* Number of distinct slab colors. */
+    size_t next_color;          /* Color of the next new slab. */
+    void (*ctor) (void *);      /* Constructor, or a null pointer. */
+    struct lock lock;           /* Protects everything below. */
+    struct list partial;        /* Slabs with some objects in use. */
+    struct list full;           /* Slabs with all objects in use. */
+    struct list empty;          /* Slabs with no objects in use. */
+    size_t empty_cnt;           /* Number of slabs in EMPTY. */
+    size_t slab_cnt;            /* Number of slabs. */
+    size_t active;              /* Number of objects in use. */
+    struct list_elem elem;      /* Element in the list of all caches. */
+  };
+
+void slab_init (void);
+void slab_cache_init (struct slab_cache *, const char *name, size_t size,
+                      void (*ctor) (void *));
+void slab_cache_destroy (struct slab_cache *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
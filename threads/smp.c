@@ -0,0 +1,303 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <packed.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
+
+/* Symmetric multiprocessing support.
+
+   At boot only the bootstrap processor (BSP) runs.  smp_init()
+   looks for other processors in the BIOS's MultiProcessor
+   Specification tables and starts each of these application
+   processors (APs) with an INIT-STARTUP-STARTUP IPI sequence.
+   Each AP then runs the code in ap-start.S, which calls
+   ap_main() below, and from then on schedules threads off its
+   own run queue.  See [MP] for the table formats. */
+
+/* All the CPUs in the system. */
+struct cpu cpus[CPU_MAX];
+
+/* Number of CPUs in cpus[].  Only those with `started' set are
+   actually running. */
+int cpu_cnt = 1;
+
+/* MP floating pointer structure.  See [MP] 4.1. */
+struct mp_fps
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of config table. */
+    uint8_t length;             /* Length in 16-byte paragraphs. */
+    uint8_t revision;           /* MP specification revision. */
+    uint8_t checksum;           /* All bytes sum to 0. */
+    uint8_t type;               /* Default configuration, or 0. */
+    uint8_t features[4];        /* Other feature bytes. */
+  }
+PACKED;
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of base table in bytes. */
+    uint8_t revision;           /* MP specification revision. */
+    uint8_t checksum;           /* All bytes of base table sum to 0. */
+    char oem[20];               /* OEM and product IDs. */
+    uint32_t oem_table;         /* Physical address of OEM table. */
+    uint16_t oem_length;        /* Size of OEM table. */
+    uint16_t entry_cnt;         /* Number of entries after header. */
+    uint32_t lapic;             /* Physical address of local APICs. */
+    uint16_t ext_length;        /* Length of extended entries. */
+    uint8_t ext_checksum;       /* Checksum of extended entries. */
+    uint8_t reserved;
+  }
+PACKED;
+
+/* MP configuration table processor entry.  See [MP] 4.3.1. */
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;       /* Local APIC version. */
+    uint8_t flags;              /* MP_ENABLED, MP_BSP. */
+    uint32_t signature;         /* CPU signature. */
+    uint32_t features;          /* CPUID feature flags. */
+    uint32_t reserved[2];
+  }
+PACKED;
+
+/* MP configuration table entry types and their sizes. */
+#define MP_PROCESSOR 0          /* Processor, 20 bytes. */
+#define MP_OTHER_SIZE 8         /* Size of every other entry type. */
+
+/* struct mp_processor flags. */
+#define MP_ENABLED 0x01         /* Processor is usable. */
+#define MP_BSP 0x02             /* Processor is the BSP. */
+
+/* Defined in ap-start.S. */
+extern char ap_trampoline_start[], ap_trampoline_end[];
+extern char ap_boot_cr3[], ap_boot_esp[];
+
+void ap_main (void) NO_RETURN;
+
+static intr_handler_func reschedule_interrupt;
+static uint32_t find_cpus (void);
+static struct mp_fps *find_fps (void);
+static struct mp_fps *scan_fps (uint32_t paddr, size_t length);
+static bool checksum_ok (const void *, size_t length);
+static void start_aps (void);
+static bool start_ap (struct cpu *);
+
+/* Detects the processors in the system and starts all of them.
+   Must be called on the BSP with interrupts on, after the timer
+   has been calibrated and before any user process is created.
+   On a uniprocessor this does nothing at all. */
+void
+smp_init (void)
+{
+  uint32_t lapic_paddr;
+  int started = 1;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  lapic_paddr = find_cpus ();
+  if (lapic_paddr == 0 || cpu_cnt < 2)
+    {
+      cpu_cnt = 1;
+      return;
+    }
+
+  lapic_bsp_init (lapic_paddr);
+  intr_register_ext (LAPIC_RESCHED_VEC, reschedule_interrupt,
+                     "Reschedule IPI");
+  start_aps ();
+
+  for (i = 1; i < cpu_cnt; i++)
+    if (cpus[i].started)
+      started++;
+  printf ("%d of %d CPUs online.\n", started, cpu_cnt);
+}
+
+/* Sends a reschedule IPI to CPU, so that it rechecks the run
+   queues if it is idle. */
+void
+smp_send_reschedule (struct cpu *cpu)
+{
+  ASSERT (cpu != cpu_current ());
+  lapic_send_ipi (cpu->apic_id, LAPIC_RESCHED_VEC);
+}
+
+/* C entry point for the APs, called by ap-start.S on the stack
+   of the AP's idle thread. */
+void
+ap_main (void)
+{
+  intr_init_ap ();
+  fpu_init_ap ();
+#ifdef USERPROG
+  gdt_init_ap ();
+#endif
+  lapic_ap_init ();
+  thread_start_ap ();
+}
+
+/* Reschedule IPI handler.  Another CPU made a thread ready while
+   this CPU was idle, so give the scheduler a chance to steal
+   it. */
+static void
+reschedule_interrupt (struct intr_frame *args UNUSED)
+{
+  if (thread_current () == cpu_current ()->idle_thread)
+    intr_yield_on_return ();
+}
+
+/* Fills in cpus[] and cpu_cnt from the MP configuration table,
+   with the BSP in cpus[0].  Returns the physical address of the
+   local APICs, or 0 if there is no usable MP configuration
+   table. */
+static uint32_t
+find_cpus (void)
+{
+  struct mp_fps *fps = find_fps ();
+  struct mp_config *config;
+  uint8_t *entry;
+  int i;
+
+  if (fps == NULL || fps->type != 0 || fps->config == 0
+      || fps->config >= init_ram_pages * PGSIZE)
+    return 0;
+  config = ptov (fps->config);
+  if (memcmp (config->signature, "PCMP", 4)
+      || !checksum_ok (config, config->length))
+    return 0;
+
+  cpu_cnt = 1;
+  entry = (uint8_t *) (config + 1);
+  for (i = 0; i < config->entry_cnt; i++)
+    if (*entry == MP_PROCESSOR)
+      {
+        struct mp_processor *p = (struct mp_processor *) entry;
+        if (p->flags & MP_BSP)
+          cpus[0].apic_id = p->apic_id;
+        else if ((p->flags & MP_ENABLED) && cpu_cnt < CPU_MAX)
+          {
+            cpus[cpu_cnt].id = cpu_cnt;
+            cpus[cpu_cnt].apic_id = p->apic_id;
+            cpu_cnt++;
+          }
+        entry += sizeof *p;
+      }
+    else
+      entry += MP_OTHER_SIZE;
+
+  return config->lapic;
+}
+
+/* Searches the places listed in [MP] 4 for the MP floating
+   pointer structure.  Returns it, or a null pointer if there is
+   none. */
+static struct mp_fps *
+find_fps (void)
+{
+  uint16_t ebda_seg = *(uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_fps *fps = NULL;
+
+  if (ebda_seg != 0)
+    fps = scan_fps ((uint32_t) ebda_seg << 4, 1024);
+  if (fps == NULL)
+    fps = scan_fps ((uint32_t) base_kb * 1024 - 1024, 1024);
+  if (fps == NULL)
+    fps = scan_fps (0xf0000, 0x10000);
+  return fps;
+}
+
+/* Looks for the MP floating pointer structure in the LENGTH
+   bytes of physical memory starting at PADDR. */
+static struct mp_fps *
+scan_fps (uint32_t paddr, size_t length)
+{
+  uint8_t *p = ptov (paddr);
+  uint8_t *end = p + length;
+
+  for (; p + sizeof (struct mp_fps) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && checksum_ok (p, sizeof (struct mp_fps)))
+      return (struct mp_fps *) p;
+  return NULL;
+}
+
+/* Returns true if the LENGTH bytes at P sum to 0 mod 256. */
+static bool
+checksum_ok (const void *p_, size_t length)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (length-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Starts every AP in cpus[]. */
+static void
+start_aps (void)
+{
+  uint8_t *trampoline = ptov (AP_TRAMPOLINE_BASE);
+  uint32_t *pd = init_page_dir;
+  int i;
+
+  /* Let the APs run at the low physical addresses they start at
+     for a moment after they turn on paging. */
+  pd[0] = pd[pd_no (PHYS_BASE)];
+
+  memcpy (trampoline, ap_trampoline_start,
+          ap_trampoline_end - ap_trampoline_start);
+  *(uint32_t *) (trampoline + (ap_boot_cr3 - ap_trampoline_start))
+    = vtop (init_page_dir);
+
+  for (i = 1; i < cpu_cnt; i++)
+    if (!start_ap (&cpus[i]))
+      printf ("CPU %d (APIC ID %d) failed to start.\n",
+              i, cpus[i].apic_id);
+
+  /* Tear down the identity mapping again.  User page directories
+     are copied from init_page_dir, so it must not leak into
+     them. */
+  pd[0] = 0;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+}
+
+/* Starts the AP described by CPU, using the INIT-STARTUP-STARTUP
+   sequence of [MP] B.4.  Returns true once it is running. */
+static bool
+start_ap (struct cpu *cpu)
+{
+  uint8_t *trampoline = ptov (AP_TRAMPOLINE_BASE);
+  int i;
+
+  *(uint32_t *) (trampoline + (ap_boot_esp - ap_trampoline_start))
+    = (uint32_t) thread_prepare_ap (cpu);
+
+  lapic_send_init (cpu->apic_id);
+  timer_msleep (10);
+  lapic_send_startup (cpu->apic_id, AP_TRAMPOLINE_BASE);
+  timer_udelay (200);
+  if (!cpu->started)
+    lapic_send_startup (cpu->apic_id, AP_TRAMPOLINE_BASE);
+
+  for (i = 0; i < 100 && !cpu->started; i++)
+    timer_mdelay (1);
+  return cpu->started;
+}
@@ -0,0 +1,61 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+/* Maximum number of CPUs supported. */
+#define CPU_MAX 8
+
+/* Physical address to which the application processor startup
+   code in ap-start.S is copied.  Must be page-aligned and below
+   1 MB, because APs begin executing in real mode at the page
+   given by the STARTUP IPI's vector. */
+#define AP_TRAMPOLINE_BASE 0x8000
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Per-CPU state.
+
+   Everything in here belongs to one processor.  It is only
+   accessed by that processor, or by another processor while
+   interrupts are off (see the global interrupt lock in
+   interrupt.c). */
+struct cpu
+  {
+    int id;                             /* Index into cpus[]. */
+    uint8_t apic_id;                    /* Local APIC ID. */
+    volatile bool started;              /* Set once the CPU is running. */
+
+    /* Owned by thread.c. */
+    struct thread *idle_thread;         /* This CPU's idle thread. */
+    struct thread *current;             /* Thread running on this CPU. */
+    int64_t ticks;                      /* # of timer ticks on this CPU. */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+    unsigned mlfqs_epoch;               /* MLFQS epoch last refreshed in. */
+
+    /* Owned by rcu.c. */
+    unsigned rcu_seq;                   /* Last grace period reported in. */
+
+    /* Owned by fpu.c. */
+    struct thread *fpu_owner;           /* Whose state the FPU holds. */
+    bool fpu_kernel;                    /* In a kernel SIMD region? */
+
+    /* Owned by interrupt.c. */
+    bool in_external_intr;              /* Processing an external interrupt? */
+    bool yield_on_return;               /* Yield on interrupt return? */
+  };
+
+/* All the CPUs in the system.  The bootstrap processor, the one
+   running main(), is always cpus[0]. */
+extern struct cpu cpus[CPU_MAX];
+
+/* Number of CPUs in cpus[]. */
+extern int cpu_cnt;
+
+struct cpu *cpu_current (void);
+
+void smp_init (void);
+void smp_send_reschedule (struct cpu *);
+#endif
+
+#endif /* threads/smp.h */
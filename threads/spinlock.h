@@ -0,0 +1,63 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+
+/* Spin lock.
+
+   A spin lock protects data that is shared between CPUs.  Unlike
+   a `struct lock', waiting for a spin lock never sleeps: the CPU
+   simply retries until the holder releases it, so spin locks
+   must only be held for short stretches of code that cannot
+   block.  Spin locks do not touch the interrupt flag; callers
+   that may be interrupted while holding one must turn interrupts
+   off themselves. */
+struct spinlock
+  {
+    volatile int locked;        /* 1 if held, 0 if free. */
+  };
+
+/* Initializer for a spin lock that is not held. */
+#define SPINLOCK_INITIALIZER { 0 }
+
+/* Initializes LOCK as not held. */
+static inline void
+spinlock_init (struct spinlock *lock)
+{
+  lock->locked = 0;
+}
+
+/* Tries to acquire LOCK without waiting.  Returns true if
+   successful, false if LOCK is held by someone else. */
+static inline bool
+spinlock_try_acquire (struct spinlock *lock)
+{
+  /* XCHG with a memory operand is implicitly locked, so it is
+     atomic with respect to the other CPUs and also acts as a
+     full memory barrier.  See [IA32-v2b] "XCHG". */
+  int old = 1;
+  asm volatile ("xchgl %0, %1"
+                : "+r" (old), "+m" (lock->locked) : : "memory");
+  return old == 0;
+}
+
+/* Acquires LOCK, spinning until it becomes available. */
+static inline void
+spinlock_acquire (struct spinlock *lock)
+{
+  while (!spinlock_try_acquire (lock))
+    while (lock->locked)
+      asm volatile ("pause" : : : "memory");
+}
+
+/* Releases LOCK, which must be held by the caller. */
+static inline void
+spinlock_release (struct spinlock *lock)
+{
+  /* x86 does not reorder a store with earlier loads or stores,
+     so a compiler barrier suffices. */
+  asm volatile ("" : : : "memory");
+  lock->locked = 0;
+}
+
+#endif /* threads/spinlock.h */
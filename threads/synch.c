@@ -31,10 +31,46 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/clock.h"
+
+#ifdef LOCKSTAT
+/* Lock contention statistics.
+
+   Locks are counted by class, that is, by the name they were
+   initialized with, so that the statistics outlive locks on the
+   stack or in freed memory, and so that locks of a kind, such as
+   those of every malloc() descriptor, are counted together.
+   Classes are never freed.  The table is protected by disabling
+   interrupts. */
+#define LOCK_CLASS_CNT 64
+static struct lock_class lock_classes[LOCK_CLASS_CNT];
+static int lock_class_cnt;
+static long long unclassified;  /* Locks initialized with the table full. */
+
+static struct lock_class *lock_class_get (const char *name);
+static void lockstat_acquired (struct lock *, int64_t wait_start,
+                               bool contended);
+static void lockstat_released (struct lock *);
+static void lockstat_donated (struct lock *);
+#endif
+
+/* Order of arrival of waiting threads, which breaks ties in
+   priority so that waiters of equal priority are woken first
+   come, first served.  Compared by difference, so that it may
+   wrap around.  Protected by disabling interrupts. */
+static unsigned next_wait_seq;
+
+static bool thread_priority_less (const struct heap_elem *,
+                                  const struct heap_elem *, void *aux);
+static bool waiter_priority_less (const struct heap_elem *,
+                                  const struct heap_elem *, void *aux);
+static void reorder_waiter (struct heap *, struct heap_elem *,
+                            bool raised);
+void donate_priority (struct lock *);
+static void donate_rwlock_priority (struct rwlock *);
+static int get_rwlock_priority (const struct rwlock *);
+static void restore_priority (struct thread *);
 
-
-bool semaphore_priority_comparator (struct list_elem *first,
-                                    struct list_elem *second, void *aux);
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -50,7 +86,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, thread_priority_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -71,8 +107,8 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_insert_ordered (&sema->waiters, &thread_current ()->elem,
-                              priority_comparator, NULL);
+      thread_current ()->wait_seq = next_wait_seq++;
+      heap_insert (&sema->waiters, &thread_current ()->wait_elem);
       thread_current ()->waiting_sema = sema;
       thread_block ();
       thread_current ()->waiting_sema = NULL;
@@ -119,10 +155,10 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
   struct thread *t = NULL;
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) 
+  if (!heap_empty (&sema->waiters)) 
     {
-      t = list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem);
+      t = heap_entry (heap_pop (&sema->waiters), struct thread, wait_elem);
+      t->waiting_sema = NULL;
       thread_unblock (t);
     }
   sema->value++;
@@ -177,11 +213,10 @@ int
 get_semaphore_priority (struct semaphore *sema)
 {
   ASSERT (sema != NULL);
-  if (list_empty (&sema->waiters))
+  if (heap_empty (&sema->waiters))
     return PRI_MIN;
-  struct list_elem *front = list_front (&sema->waiters);
-  struct thread *t = list_entry (front, struct thread, elem);
-  return t->priority;
+  return heap_entry (heap_front (&sema->waiters),
+                     struct thread, wait_elem)->priority;
 }
 
 /* Returns the priority of the highest-priority thread waiting
@@ -194,35 +229,51 @@ get_lock_priority (struct lock *lock)
   return get_semaphore_priority (&lock->semaphore);
 }
 
-/* Compares two locks and returns true if the priority of the first lock
-   is greater than that of the second lock */
-bool
-lock_list_priority_comparator (struct list_elem *first,
-                               struct list_elem *second, void *aux)
+/* Moves T, whose priority just changed from OLD_PRIORITY, to its
+   new place among the waiters of the semaphore and condition
+   variable it is waiting on, if any. */
+void
+synch_priority_changed (struct thread *t, int old_priority)
 {
-  ASSERT (first != NULL);
-  ASSERT (second != NULL);
-  struct lock *first_lock = list_entry (first, struct lock, elem);
-  struct lock *second_lock = list_entry (second, struct lock, elem);
-  return get_lock_priority (first_lock) > get_lock_priority (second_lock);
+  enum intr_level old_level;
+  bool raised = t->priority > old_priority;
+
+  if (t->priority == old_priority)
+    return;
+
+  old_level = intr_disable ();
+  if (t->waiting_sema != NULL)
+    reorder_waiter (&t->waiting_sema->waiters, &t->wait_elem, raised);
+  if (t->waiting_condvar != NULL)
+    reorder_waiter (&t->waiting_condvar->waiters, t->waiting_cond_elem,
+                    raised);
+  if (t->waiting_rwlock != NULL && t->waiting_rwlock->upgrader != t)
+    reorder_waiter (&t->waiting_rwlock->waiters, &t->wait_elem, raised);
+  intr_set_level (old_level);
 }
 
-/* Sorts the list of threads waiting on the semaphore sema */
-void
-sort_sema_waiters (struct semaphore *sema)
+/* Restores the order of WAITERS after the priority of the thread
+   that ELEM stands for was RAISED or lowered. */
+static void
+reorder_waiter (struct heap *waiters, struct heap_elem *elem, bool raised)
 {
-  if (sema == NULL)
-    return;
-  list_sort (&sema->waiters, priority_comparator, NULL);
+  if (raised)
+    heap_promote (waiters, elem);
+  else
+    heap_update (waiters, elem);
 }
 
-/* Sorts the list of threads waiting on the conditional variable condvar */
-void
-sort_condvar_waiters (struct condition *condvar)
+/* Raises the priority of T to that of the current thread and
+   passes it on to whatever T is waiting on. */
+static void
+donate_to_thread (struct thread *t)
 {
-  if (condvar == NULL)
-    return;
-  list_sort (&condvar->waiters, semaphore_priority_comparator, NULL);
+  int old_priority = t->priority;
+
+  thread_update_priority (t, thread_get_priority ());
+  synch_priority_changed (t, old_priority);
+  donate_priority (t->waiting_lock);
+  donate_rwlock_priority (t->waiting_rwlock);
 }
 
 /* Called when the current thread calling lock_acquire has a higher priority
@@ -238,19 +289,79 @@ donate_priority (struct lock *lock)
     {
       if (thread_get_priority () > lock->holder->priority)
         {
-          lock->holder->priority = thread_get_priority ();
-          donate_priority (lock->holder->waiting_lock);
-          if (lock->holder->waiting_lock != NULL)
-            sort_sema_waiters (&lock->holder->waiting_lock->semaphore);
-          if (lock->holder->waiting_sema != NULL)
-            sort_sema_waiters (lock->holder->waiting_sema);
-          if (lock->holder->waiting_condvar != NULL)
-            sort_condvar_waiters (lock->holder->waiting_condvar);
+#ifdef LOCKSTAT
+          lockstat_donated (lock);
+#endif
+          donate_to_thread (lock->holder);
         }
     }
   return;
 }
 
+/* Like donate_priority(), but donates to every holder of RWLOCK,
+   since a waiter can only get in once all of them are gone. */
+static void
+donate_rwlock_priority (struct rwlock *rwlock)
+{
+  struct list_elem *e;
+
+  if (rwlock == NULL)
+    return;
+  for (e = list_begin (&rwlock->holders); e != list_end (&rwlock->holders);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct rwlock_hold, elem)->thread;
+
+      if (thread_get_priority () > t->priority)
+        donate_to_thread (t);
+    }
+}
+
+/* Returns the priority of the highest-priority thread waiting
+   on RWLOCK, including a reader waiting to upgrade. */
+static int
+get_rwlock_priority (const struct rwlock *rwlock)
+{
+  int priority = PRI_MIN;
+
+  if (!heap_empty (&rwlock->waiters))
+    priority = heap_entry (heap_front (&rwlock->waiters),
+                           struct thread, wait_elem)->priority;
+  if (rwlock->upgrader != NULL && rwlock->upgrader->priority > priority)
+    priority = rwlock->upgrader->priority;
+  return priority;
+}
+
+/* Drops the priority of T, which just released a lock or
+   reader-writer lock, back to the highest of its own priority
+   and the priorities donated through the locks it still holds. */
+static void
+restore_priority (struct thread *t)
+{
+  int priority = t->orig_priority;
+  struct list_elem *e;
+  int i;
+
+  /* The priorities of the locks change as threads start and stop
+     waiting on them, so T's few locks are kept in no particular
+     order and searched here. */
+  for (e = list_begin (&t->acquired_locks); e != list_end (&t->acquired_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      if (get_lock_priority (lock) > priority)
+        priority = get_lock_priority (lock);
+    }
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    {
+      struct rwlock *rwlock = t->rwlock_holds[i].rwlock;
+
+      if (rwlock != NULL && get_rwlock_priority (rwlock) > priority)
+        priority = get_rwlock_priority (rwlock);
+    }
+  t->priority = priority;
+}
+
 /* Initializes LOCK.  A lock can be held by at most a single
    thread at any given time.  Our locks are not "recursive", that
    is, it is an error for the thread currently holding a lock to
@@ -265,14 +376,26 @@ donate_priority (struct lock *lock)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   When the kernel is built with -DLOCKSTAT, the lock's
+   contention statistics are counted under NAME.  Otherwise,
+   lock_init_named() is just lock_init(). */
+#ifdef LOCKSTAT
+void
+lock_init_named (struct lock *lock, const char *name)
+#else
 void
 lock_init (struct lock *lock)
+#endif
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+#ifdef LOCKSTAT
+  lock->class = lock_class_get (name);
+#endif
 }
 
 static void lock_acquire_ps (struct lock *);
@@ -290,6 +413,11 @@ static void lock_acquire_mlfqs (struct lock *);
 void
 lock_acquire (struct lock *lock)
 {
+#ifdef LOCKSTAT
+  int64_t wait_start = clock_ns ();
+  bool contended = lock->semaphore.value == 0;
+#endif
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
@@ -303,6 +431,9 @@ lock_acquire (struct lock *lock)
         lock_acquire_ps (lock);
     }
   thread_current ()->waiting_lock = NULL;
+#ifdef LOCKSTAT
+  lockstat_acquired (lock, wait_start, contended);
+#endif
 }
 
 /* Handles the priority donation with the Priority Scheduler(PS)
@@ -313,11 +444,9 @@ static void
 lock_acquire_ps (struct lock *lock)
 {
   donate_priority (lock);
-  priority_sort_ready_list ();
   sema_down (&lock->semaphore);
   lock->holder = thread_current ();
-  list_insert_ordered (&thread_current ()->acquired_locks, &lock->elem,
-                       lock_list_priority_comparator, NULL);
+  list_push_back (&thread_current ()->acquired_locks, &lock->elem);
 }
 
 /* Checks for the availability of the required lock if it is available 
@@ -348,8 +477,11 @@ lock_try_acquire (struct lock *lock)
   if (success)
     {
       lock->holder = thread_current ();
-      list_insert_ordered (&thread_current ()->acquired_locks, &lock->elem,
-                           lock_list_priority_comparator, NULL);
+      if (scheduler != MLFQ_SCHEDULER)
+        list_push_back (&thread_current ()->acquired_locks, &lock->elem);
+#ifdef LOCKSTAT
+      lockstat_acquired (lock, 0, false);
+#endif
     }
   return success;
 }
@@ -358,18 +490,7 @@ static void
 lock_release_ps (struct lock *lock)
 {
   list_remove (&lock->elem);
-  if (list_empty (&thread_current ()->acquired_locks))
-    thread_current ()->priority = thread_current ()->orig_priority;
-  else
-    {
-      struct lock *donating_lock = list_entry (list_front (
-                      &thread_current ()->acquired_locks), struct lock, elem);
-      if (get_lock_priority (donating_lock) > thread_current ()->orig_priority)
-        thread_current ()->priority = get_lock_priority (donating_lock);
-      else
-        thread_current ()->priority = thread_current ()->orig_priority;
-    }
-  priority_sort_ready_list ();
+  restore_priority (thread_current ());
 }
 
 /* Releases LOCK, which must be owned by the current thread.
@@ -383,6 +504,9 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
   
+#ifdef LOCKSTAT
+  lockstat_released (lock);
+#endif
   lock->holder = NULL;
   switch (scheduler)
     {
@@ -405,11 +529,140 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+#ifdef LOCKSTAT
+/* Returns the statistics class named NAME, creating it if
+   necessary, or a null pointer if there is no room for it. */
+static struct lock_class *
+lock_class_get (const char *name)
+{
+  struct lock_class *c = NULL;
+  enum intr_level old_level;
+  int i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < lock_class_cnt; i++)
+    if (!strcmp (lock_classes[i].name, name))
+      {
+        c = &lock_classes[i];
+        break;
+      }
+  if (c == NULL)
+    {
+      if (lock_class_cnt < LOCK_CLASS_CNT)
+        {
+          c = &lock_classes[lock_class_cnt++];
+          c->name = name;
+        }
+      else
+        unclassified++;
+    }
+  intr_set_level (old_level);
+  return c;
+}
+
+/* Counts an acquisition of LOCK by the current thread, which
+   started waiting for it at WAIT_START if CONTENDED is true. */
+static void
+lockstat_acquired (struct lock *lock, int64_t wait_start, bool contended)
+{
+  struct lock_class *c = lock->class;
+  int64_t now = clock_ns ();
+  enum intr_level old_level;
+
+  lock->acquired_at = now;
+  if (c == NULL)
+    return;
+
+  old_level = intr_disable ();
+  c->acquisitions++;
+  if (contended)
+    {
+      int64_t wait = now - wait_start;
+      c->contentions++;
+      c->wait_total += wait;
+      if (wait > c->wait_max)
+        c->wait_max = wait;
+    }
+  intr_set_level (old_level);
+}
+
+/* Counts the time LOCK was held, just before it is released. */
+static void
+lockstat_released (struct lock *lock)
+{
+  struct lock_class *c = lock->class;
+  int64_t hold = clock_ns () - lock->acquired_at;
+  enum intr_level old_level;
+
+  if (c == NULL)
+    return;
+
+  old_level = intr_disable ();
+  c->hold_total += hold;
+  if (hold > c->hold_max)
+    c->hold_max = hold;
+  intr_set_level (old_level);
+}
+
+/* Counts a priority donation to the holder of LOCK. */
+static void
+lockstat_donated (struct lock *lock)
+{
+  enum intr_level old_level;
+
+  if (lock->class == NULL)
+    return;
+
+  old_level = intr_disable ();
+  lock->class->donations++;
+  intr_set_level (old_level);
+}
+
+/* Prints the statistics of every class of locks that was ever
+   acquired, most waited for first. */
+void
+lock_print_stats (void)
+{
+  static struct lock_class classes[LOCK_CLASS_CNT];
+  enum intr_level old_level;
+  int cnt, i, j;
+
+  /* Printing takes the console lock, so work on a copy. */
+  old_level = intr_disable ();
+  cnt = lock_class_cnt;
+  memcpy (classes, lock_classes, sizeof classes);
+  intr_set_level (old_level);
+
+  /* Sort by total wait, descending. */
+  for (i = 1; i < cnt; i++)
+    for (j = i; j > 0 && classes[j].wait_total > classes[j - 1].wait_total;
+         j--)
+      {
+        struct lock_class tmp = classes[j];
+        classes[j] = classes[j - 1];
+        classes[j - 1] = tmp;
+      }
+
+  printf ("Locks: %d classes, %lld unclassified locks\n", cnt, unclassified);
+  printf ("  %10s %10s %10s %10s %8s %8s %7s  %s\n", "wait ns", "max wait",
+          "hold ns", "max hold", "acquired", "waited", "donated", "name");
+  for (i = 0; i < cnt; i++)
+    if (classes[i].acquisitions > 0)
+      printf ("  %10lld %10lld %10lld %10lld %8lld %8lld %7lld  %s\n",
+              classes[i].wait_total, classes[i].wait_max,
+              classes[i].hold_total, classes[i].hold_max,
+              classes[i].acquisitions, classes[i].contentions,
+              classes[i].donations, classes[i].name);
+}
+#endif /* LOCKSTAT */
+
+/* One semaphore in a condition variable's waiters. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
+    unsigned seq;                       /* Arrival order. */
   };
 
 /* Initializes condition variable COND.  A condition variable
@@ -420,21 +673,39 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  heap_init (&cond->waiters, waiter_priority_less, NULL);
 }
 
-/* Compares two semaphores and returns true if the priority of the first semaphore
-   is greater than that of the second semaphore */
-bool
-semaphore_priority_comparator (struct list_elem *first,
-                               struct list_elem *second, void *aux)
+/* Returns true if thread A_ should be woken before thread B_,
+   because it has a higher priority or, at equal priorities,
+   because it started waiting first. */
+static bool
+thread_priority_less (const struct heap_elem *a_, const struct heap_elem *b_,
+                      void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+  const struct thread *b = heap_entry (b_, struct thread, wait_elem);
+
+  if (a->priority != b->priority)
+    return a->priority > b->priority;
+  return (int) (a->wait_seq - b->wait_seq) < 0;
+}
+
+/* Returns true if the thread waiting on semaphore_elem A_ should
+   be signaled before the one waiting on B_, like
+   thread_priority_less(). */
+static bool
+waiter_priority_less (const struct heap_elem *a_, const struct heap_elem *b_,
+                      void *aux UNUSED)
 {
-  struct semaphore_elem *first_sema = list_entry (first,
-                                          struct semaphore_elem, elem);
-  struct semaphore_elem *second_sema = list_entry (second,
-                                          struct semaphore_elem, elem);
-  return get_semaphore_priority (&first_sema->semaphore) 
-      > get_semaphore_priority (&second_sema->semaphore);
+  const struct semaphore_elem *a = heap_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = heap_entry (b_, struct semaphore_elem,
+                                               elem);
+
+  if (a->thread->priority != b->thread->priority)
+    return a->thread->priority > b->thread->priority;
+  return (int) (a->seq - b->seq) < 0;
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -460,7 +731,10 @@ semaphore_priority_comparator (struct list_elem *first,
 void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
+  struct thread *cur = thread_current ();
   struct semaphore_elem waiter;
+  enum intr_level old_level;
+  int old_priority;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -468,12 +742,21 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = cur;
   
-  list_push_back (&cond->waiters, &waiter.elem);
+  old_level = intr_disable ();
+  waiter.seq = next_wait_seq++;
+  heap_insert (&cond->waiters, &waiter.elem);
+  cur->waiting_condvar = cond;
+  cur->waiting_cond_elem = &waiter.elem;
+  intr_set_level (old_level);
+
+  /* Releasing LOCK may end a donation to us. */
+  old_priority = cur->priority;
   lock_release (lock);
-  thread_current ()->waiting_condvar = cond; 
+  synch_priority_changed (cur, old_priority);
+
   sema_down (&waiter.semaphore);
-  thread_current ()->waiting_condvar = NULL;
   lock_acquire (lock);
 }
 
@@ -487,17 +770,24 @@ cond_wait (struct condition *cond, struct lock *lock)
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) 
 {
+  struct semaphore_elem *waiter = NULL;
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
+  old_level = intr_disable ();
+  if (!heap_empty (&cond->waiters)) 
     {
-      list_sort (&cond->waiters, semaphore_priority_comparator, NULL);
-      sema_up (&list_entry (list_pop_front (&cond->waiters),
-                                struct semaphore_elem, elem)->semaphore);
+      waiter = heap_entry (heap_pop (&cond->waiters),
+                           struct semaphore_elem, elem);
+      waiter->thread->waiting_condvar = NULL;
     }
+  intr_set_level (old_level);
+  if (waiter != NULL)
+    sema_up (&waiter->semaphore);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -514,8 +804,316 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  list_sort (&cond->waiters, semaphore_priority_comparator, NULL);
-  while (!list_empty (&cond->waiters))
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                              struct semaphore_elem, elem)->semaphore);
+  while (!heap_empty (&cond->waiters))
+    cond_signal (cond, lock);
+}
+
+/* Initializes RWLOCK.  A reader-writer lock can be held by any
+   number of readers at once, or by a single writer.
+
+   Once a writer is waiting, new readers wait too, so that a
+   steady stream of readers cannot starve writers.  Waiting
+   threads are let in by priority, and like locks, reader-writer
+   locks donate the priority of waiting threads to the holders,
+   to all of them if there are several readers.
+
+   Our reader-writer locks are not recursive, and a thread may
+   hold at most RWLOCK_HOLD_MAX of them at a time. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  rwlock->readers = 0;
+  rwlock->writer = NULL;
+  rwlock->upgrader = NULL;
+  rwlock->writers_waiting = 0;
+  list_init (&rwlock->holders);
+  heap_init (&rwlock->waiters, thread_priority_less, NULL);
+}
+
+/* Returns the current thread's hold on RWLOCK, or a null pointer
+   if it does not hold RWLOCK. */
+static struct rwlock_hold *
+rwlock_find_hold (const struct rwlock *rwlock)
+{
+  struct thread *cur = thread_current ();
+  int i;
+
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    if (cur->rwlock_holds[i].rwlock == rwlock)
+      return &cur->rwlock_holds[i];
+  return NULL;
+}
+
+/* Records that T holds RWLOCK, in a free hold that the caller
+   has made sure T has. */
+static void
+rwlock_add_holder (struct rwlock *rwlock, struct thread *t)
+{
+  int i;
+
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    if (t->rwlock_holds[i].rwlock == NULL)
+      {
+        t->rwlock_holds[i].rwlock = rwlock;
+        t->rwlock_holds[i].thread = t;
+        list_push_back (&rwlock->holders, &t->rwlock_holds[i].elem);
+        return;
+      }
+  NOT_REACHED ();
+}
+
+/* Blocks the current thread on RWLOCK until some other thread
+   lets it in, donating its priority to the holders meanwhile.
+   Interrupts must be off. */
+static void
+rwlock_wait (struct rwlock *rwlock, bool write)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cur->waiting_rwlock = rwlock;
+  cur->waiting_rwlock_write = write;
+  if (rwlock->upgrader != cur)
+    {
+      cur->wait_seq = next_wait_seq++;
+      heap_insert (&rwlock->waiters, &cur->wait_elem);
+      if (write)
+        rwlock->writers_waiting++;
+    }
+  if (scheduler != MLFQ_SCHEDULER)
+    donate_rwlock_priority (rwlock);
+  thread_block ();
+  ASSERT (cur->waiting_rwlock == NULL);
+}
+
+/* Lets T, waiting on RWLOCK, in and wakes it up. */
+static void
+rwlock_grant (struct rwlock *rwlock, struct thread *t)
+{
+  if (t->waiting_rwlock_write)
+    rwlock->writer = t;
+  else
+    rwlock->readers++;
+  rwlock_add_holder (rwlock, t);
+  t->waiting_rwlock = NULL;
+  thread_unblock (t);
+}
+
+/* Lets in as many threads waiting on RWLOCK as it allows: the
+   upgrading reader once it is the last reader, or else the
+   waiters in priority order up to the first writer, which only
+   gets in if it is first.  Returns the highest priority among
+   the threads let in, or PRI_MIN if none was.  Interrupts must
+   be off. */
+static int
+rwlock_wake (struct rwlock *rwlock)
+{
+  int priority = PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (rwlock->writer != NULL)
+    return priority;
+  if (rwlock->upgrader != NULL)
+    {
+      struct thread *t = rwlock->upgrader;
+
+      if (rwlock->readers == 1)
+        {
+          rwlock->readers = 0;
+          rwlock->writer = t;
+          rwlock->upgrader = NULL;
+          t->waiting_rwlock = NULL;
+          priority = t->priority;
+          thread_unblock (t);
+        }
+      return priority;
+    }
+  while (!heap_empty (&rwlock->waiters))
+    {
+      struct thread *t = heap_entry (heap_front (&rwlock->waiters),
+                                     struct thread, wait_elem);
+
+      if (t->waiting_rwlock_write)
+        {
+          if (rwlock->readers > 0)
+            break;
+          rwlock->writers_waiting--;
+        }
+      heap_pop (&rwlock->waiters);
+      if (t->priority > priority)
+        priority = t->priority;
+      rwlock_grant (rwlock, t);
+      if (rwlock->writer != NULL)
+        break;
+    }
+  return priority;
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds
+   or waits for it if necessary.  RWLOCK must not already be held
+   by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rwlock));
+  ASSERT (rwlock_find_hold (NULL) != NULL);
+
+  old_level = intr_disable ();
+  if (rwlock->writer == NULL && rwlock->upgrader == NULL
+      && rwlock->writers_waiting == 0)
+    {
+      rwlock->readers++;
+      rwlock_add_holder (rwlock, thread_current ());
+    }
+  else
+    rwlock_wait (rwlock, false);
+  intr_set_level (old_level);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no one else holds
+   it if necessary.  RWLOCK must not already be held by the
+   current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rwlock));
+  ASSERT (rwlock_find_hold (NULL) != NULL);
+
+  old_level = intr_disable ();
+  if (rwlock->writer == NULL && rwlock->upgrader == NULL
+      && rwlock->readers == 0)
+    {
+      rwlock->writer = thread_current ();
+      rwlock_add_holder (rwlock, thread_current ());
+    }
+  else
+    rwlock_wait (rwlock, true);
+  intr_set_level (old_level);
+}
+
+/* Turns the current thread's read hold on RWLOCK into a write
+   hold, sleeping until the other readers are gone if necessary.
+   The upgrading reader goes ahead of waiting writers.  Only one
+   reader may be upgrading at a time: if another already is, returns
+   false at once, still holding RWLOCK for reading, and the caller
+   should release RWLOCK and acquire it for writing instead.
+   Otherwise returns true.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+rwlock_upgrade (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+  bool success = true;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rwlock_held_by_current_thread (rwlock));
+  ASSERT (!rwlock_write_held_by_current_thread (rwlock));
+
+  old_level = intr_disable ();
+  if (rwlock->upgrader != NULL)
+    success = false;
+  else if (rwlock->readers == 1)
+    {
+      rwlock->readers = 0;
+      rwlock->writer = thread_current ();
+    }
+  else
+    {
+      rwlock->upgrader = thread_current ();
+      rwlock_wait (rwlock, true);
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Turns the current thread's write hold on RWLOCK into a read
+   hold, letting in waiting readers that come before any waiting
+   writer. */
+void
+rwlock_downgrade (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+  int priority;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (rwlock_write_held_by_current_thread (rwlock));
+
+  old_level = intr_disable ();
+  rwlock->writer = NULL;
+  rwlock->readers = 1;
+  priority = rwlock_wake (rwlock);
+  intr_set_level (old_level);
+  if (priority > thread_get_priority ())
+    thread_yield ();
+}
+
+/* Releases RWLOCK, which the current thread must hold for either
+   reading or writing, and lets in the threads waiting for it that
+   now can get in. */
+void
+rwlock_release (struct rwlock *rwlock)
+{
+  struct rwlock_hold *hold;
+  enum intr_level old_level;
+  int priority;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  hold = rwlock_find_hold (rwlock);
+  ASSERT (hold != NULL);
+  list_remove (&hold->elem);
+  hold->rwlock = NULL;
+  if (rwlock->writer == thread_current ())
+    rwlock->writer = NULL;
+  else
+    rwlock->readers--;
+  priority = rwlock_wake (rwlock);
+  if (scheduler != MLFQ_SCHEDULER)
+    restore_priority (thread_current ());
+  intr_set_level (old_level);
+  if (priority > thread_get_priority ())
+    thread_yield ();
+}
+
+/* Returns true if the current thread holds RWLOCK for reading or
+   writing, false otherwise. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  return rwlock_find_hold (rwlock) != NULL;
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  return rwlock->writer == thread_current ();
 }
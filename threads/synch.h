@@ -1,14 +1,18 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -23,9 +27,40 @@ struct lock
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
     struct list_elem elem;      /* List element or lock. */
+#ifdef LOCKSTAT
+    struct lock_class *class;   /* Statistics, or a null pointer. */
+    int64_t acquired_at;        /* clock_ns() when last acquired. */
+#endif
+  };
+
+#ifdef LOCKSTAT
+/* Contention statistics, kept for each named class of locks
+   when the kernel is built with -DLOCKSTAT.  Times are in
+   nanoseconds. */
+struct lock_class
+  {
+    const char *name;           /* Name the locks were given. */
+    long long acquisitions;     /* Times acquired. */
+    long long contentions;      /* Times a thread had to wait. */
+    long long donations;        /* Priority donations to holders. */
+    int64_t wait_total;         /* Time spent waiting to acquire. */
+    int64_t wait_max;
+    int64_t hold_total;         /* Time held. */
+    int64_t hold_max;
   };
 
+/* Locks initialized with lock_init() are named after the place
+   they were initialized. */
+#define LOCK_STR(X) LOCK_STR2 (X)
+#define LOCK_STR2(X) #X
+#define lock_init(LOCK) \
+        lock_init_named (LOCK, __FILE__ ":" LOCK_STR (__LINE__))
+void lock_init_named (struct lock *, const char *name);
+void lock_print_stats (void);
+#else
 void lock_init (struct lock *);
+#define lock_init_named(LOCK, NAME) lock_init (LOCK)
+#endif
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -34,7 +69,7 @@ bool lock_held_by_current_thread (const struct lock *);
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void cond_init (struct condition *);
@@ -42,8 +77,41 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
-void sort_sema_waiters (struct semaphore *);
-void sort_condvar_waiters (struct condition *);
+/* Reader-writer lock.  Any number of readers may hold it at
+   once, or a single writer.  Writers are preferred: once a writer
+   waits, new readers wait behind it. */
+struct rwlock
+  {
+    int readers;                /* Number of readers holding it. */
+    struct thread *writer;      /* Writer holding it, or NULL. */
+    struct thread *upgrader;    /* Reader waiting to upgrade, or NULL. */
+    unsigned writers_waiting;   /* Number of writers in WAITERS. */
+    struct list holders;        /* Holders' struct rwlock_hold. */
+    struct heap waiters;        /* Waiting threads, by priority. */
+  };
+
+/* A thread's hold on a reader-writer lock, through which
+   waiters find the holders to donate their priority to. */
+struct rwlock_hold
+  {
+    struct list_elem elem;      /* Element in the lock's holders. */
+    struct rwlock *rwlock;      /* Lock held, or NULL if unused. */
+    struct thread *thread;      /* Thread holding it. */
+  };
+
+/* Reader-writer locks a thread may hold at once. */
+#define RWLOCK_HOLD_MAX 4
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_upgrade (struct rwlock *);
+void rwlock_downgrade (struct rwlock *);
+void rwlock_release (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
+void synch_priority_changed (struct thread *, int old_priority);
 
 /* Optimization barrier.
 
@@ -2,15 +2,20 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/clock.h"
 #include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -21,23 +26,63 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   Keeps one FIFO list per priority level together with a bitmap
+   of the non-empty levels, so that inserting a thread, removing
+   it and finding the highest-priority ready thread are all O(1).
+
+   Each CPU has its own run queue, indexed by CPU id.  A CPU whose
+   queue runs dry steals the highest-priority thread from the
+   longest queue of another CPU before it falls back to its idle
+   thread.  All of them are protected by the interrupt lock.
+
+   Under the fair-share scheduler, the queue is instead a
+   red-black tree ordered by virtual runtime; see below.  Ready
+   real-time threads are kept apart, in a red-black tree ordered
+   by deadline, and run before all others. */
+struct ready_queue
+  {
+    struct list levels[PRI_CNT];        /* One FIFO list per priority. */
+    uint64_t occupied;                  /* Bit P set iff levels[P] non-empty. */
+    uint64_t stale;                     /* Levels that may still hold threads
+                                           not refreshed this MLFQS epoch. */
+    int size;                           /* Number of queued threads. */
+    struct rbtree fair;                 /* Fair-share threads by vruntime. */
+    int64_t min_vruntime;               /* Fair-share virtual time floor. */
+    long long load;                     /* Sum of fair-share queued weights. */
+    struct rbtree edf;                  /* Real-time threads by deadline. */
+  };
+static struct ready_queue ready_queues[CPU_MAX];
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Cache of pages of dead threads, for reuse by thread_create().
+   The context-switch path only queues a dying thread's page with
+   call_rcu(), since RCU readers may still be looking at the
+   thread.  After a grace period, the rcu thread puts the page
+   into the cache if there is room, and otherwise onto REAP_LIST,
+   from which the reaper thread returns it to the page allocator.
+   Either way it only does a list insertion.  A recycled page is
+   not zeroed: init_thread() and thread_create() reinitialize the
+   struct thread and the initial stack frames, which is all a new
+   thread relies on.  Both lists are linked through the threads'
+   `elem' members and protected by the interrupt lock. */
+#define THREAD_CACHE_MAX 16     /* Max # of pages kept in the cache. */
+static struct list thread_cache;
+static int thread_cache_cnt;    /* # of pages in thread_cache. */
+static struct list reap_list;   /* Pages waiting to be freed. */
+static struct thread *reaper_thread;
+static bool reaper_waiting;     /* Reaper blocked waiting for work? */
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame
   {
@@ -50,12 +95,113 @@ struct kernel_thread_frame
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long cache_hits;    /* # of thread pages reused. */
+static long long cache_misses;  /* # of thread pages from palloc. */
+static long long reaped;        /* # of thread pages freed by the reaper. */
+
+/* Latency statistics, in nanoseconds. */
+struct latency
+  {
+    long long count;            /* # of samples. */
+    long long total;            /* Sum of the samples. */
+    long long max;              /* Largest sample. */
+  };
+static struct latency create_latency;  /* Of thread_create(). */
+static struct latency exit_latency;    /* From thread_exit() to recycling. */
+
+/* System-wide scheduler statistics, and histograms of the time
+   threads spend waiting in a run queue and running once
+   scheduled.  Protected by the interrupt lock. */
+static struct schedstat schedstat_total;
+static struct schedstat_hist wait_hist;
+static struct schedstat_hist run_hist;
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 static real load_avg;           /* # of threads ready to run over the past minute */
 
+/* Lazy recent_cpu decay for the MLFQS.  Instead of decaying every
+   thread's recent_cpu once per second, the timer interrupt only
+   starts a new epoch and records that second's decay coefficient.
+   Each thread remembers the epoch its recent_cpu was last brought
+   up to date in, and replays the missed decays the next time it
+   is examined. */
+#define DECAY_HISTORY 64        /* # of epochs of coefficients kept. */
+static unsigned mlfqs_epoch;    /* # of seconds elapsed under the MLFQS. */
+static real decay_history[DECAY_HISTORY]; /* Coefficient of each epoch. */
+
+/* Ready threads refreshed by each timer tick, at most.  A thread
+   is refreshed whenever it enters a run queue, so the ones still
+   to be refreshed after a new epoch begins are always at the
+   front of their levels, and each tick refreshes a few of them,
+   highest level first.  A run queue longer than this many
+   threads per tick of an epoch is only partly refreshed before
+   the next epoch begins; the threads left over are refreshed
+   when they run or are requeued. */
+#define MLFQS_REFRESH_BATCH 8
+
+/* Fair-share scheduling, after Linux's Completely Fair Scheduler.
+
+   Each thread has a weight derived from its nice value, and a
+   virtual runtime that advances by the time it runs, scaled down
+   by its weight relative to that of nice 0.  The scheduler always
+   runs the ready thread with the smallest virtual runtime, so
+   over time every thread gets a share of the CPU proportional to
+   its weight; each nice step is worth about 25% in CPU share.
+
+   A running thread is preempted once it has run for its share of
+   FAIR_LATENCY_NS, but never before FAIR_MIN_GRANULARITY_NS, and
+   only in favor of a thread with a smaller virtual runtime.
+
+   Each run queue's MIN_VRUNTIME follows the smallest virtual
+   runtime on its CPU, never going backward.  A blocked thread
+   keeps its virtual runtime relative to that floor, so that it
+   can wake up on any CPU.  A thread that slept for long gets at
+   most FAIR_LATENCY_NS / 2 of credit, and a new thread starts at
+   the floor. */
+#define FAIR_LATENCY_NS (40 * 1000 * 1000)
+#define FAIR_MIN_GRANULARITY_NS (10 * 1000 * 1000)
+#define NICE_MIN -20                    /* Lowest nice value. */
+#define NICE_MAX 20                     /* Highest nice value. */
+#define NICE_0_WEIGHT 1024              /* Weight of a nice 0 thread. */
+static const int fair_weights[NICE_MAX - NICE_MIN + 1] =
+  {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */  9548,  7620,  6100,  4904,  3906,
+    /*  -5 */  3121,  2501,  1991,  1586,  1277,
+    /*   0 */  1024,   820,   655,   526,   423,
+    /*   5 */   335,   272,   215,   172,   137,
+    /*  10 */   110,    87,    70,    56,    45,
+    /*  15 */    36,    29,    23,    18,    15,
+    /*  20 */    12,
+  };
+
+/* Earliest-deadline-first real-time scheduling.
+
+   A periodic thread declares a period, a budget of CPU time per
+   period and a deadline relative to the start of each period.
+   At every release, driven by a timer event, it starts a new job:
+   its budget is replenished and its deadline moves to the release
+   time plus the relative deadline.  Ready real-time threads always
+   run before the threads of the normal scheduling class, earliest
+   deadline first.
+
+   A job ends when the thread calls thread_wait_period().  A job
+   that ends after its deadline, or is still unfinished at the next
+   release, missed its deadline.  A job that uses up its budget is
+   throttled until the next release, so that an overrunning thread
+   cannot starve the rest of the system.
+
+   Admission control keeps the total density, the sum of BUDGET /
+   DEADLINE over all periodic threads, at most EDF_UTIL_MAX.  On a
+   single CPU that guarantees every deadline is met, and leaves
+   some time to the normal class. */
+#define EDF_UTIL_SCALE 1000000          /* Density of 1. */
+#define EDF_UTIL_MAX (EDF_UTIL_SCALE / 100 * 95)
+static long edf_util;                   /* Sum of admitted densities. */
+static struct edf_stats edf_total;      /* Job counters of all threads. */
+
 /* Boolean to indicate if the current thread getting
    created is the first initial thread in the system. */
 static bool first_init_thread;  
@@ -71,8 +217,22 @@ enum scheduler_type scheduler;
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void reaper (void *aux UNUSED);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static void thread_page_reclaim (struct rcu_head *);
+static void latency_add (struct latency *, int64_t ns);
+static void latency_print (const char *name, const struct latency *);
+static void schedstat_switch_out (struct thread *, int64_t now);
+static void schedstat_switch_in (struct thread *, int64_t now);
+static void hist_add (struct schedstat_hist *, int64_t ns);
+static void hist_print (const char *name, const struct schedstat_hist *);
+static void idle_loop (void) NO_RETURN;
+static bool is_idle_thread (struct thread *);
 static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static struct thread *next_thread_to_run (struct cpu *);
+static struct cpu *find_victim (struct cpu *thief);
+static void kick_idle_cpu (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
@@ -80,11 +240,35 @@ static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 static void thread_calculate_priority (struct thread *);
-static void thread_calculate_recent_cpu (struct thread *);
+static int thread_mlfqs_priority (struct thread *);
+static void thread_refresh_recent_cpu (struct thread *);
+static real decay_power (real, unsigned);
 static void thread_tick_ps (void);
 static void thread_tick_mlfqs (void);
+static void mlfqs_new_epoch (void);
 static void init_thread_ps (struct thread *, int);
 static void init_thread_mlfqs (struct thread *);
+static void thread_tick_fair (void);
+static int fair_weight (int nice);
+static void fair_update_curr (struct thread *);
+static bool fair_should_preempt (struct thread *);
+static void thread_tick_edf (struct thread *);
+static void edf_release (void *t);
+static bool edf_preempts (const struct thread *, const struct thread *);
+static long edf_density (int64_t budget, int64_t deadline);
+static bool edf_less (const struct rb_elem *, const struct rb_elem *,
+                      void *aux);
+static bool fair_less (const struct rb_elem *, const struct rb_elem *,
+                       void *aux);
+static void ready_queue_init (struct ready_queue *);
+static void ready_queue_push (struct ready_queue *, struct thread *);
+static void ready_queue_remove (struct ready_queue *, struct thread *);
+static struct thread *ready_queue_pop (struct ready_queue *);
+static int ready_queue_max_priority (const struct ready_queue *);
+static int ready_queue_size (const struct ready_queue *);
+static void ready_queue_refresh_mlfqs (struct ready_queue *, int budget);
+static struct ready_queue *cpu_ready_queue (const struct cpu *);
+static inline int highest_set_bit (uint64_t);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -102,11 +286,16 @@ static void init_thread_mlfqs (struct thread *);
 void
 thread_init (void)
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  lock_init_named (&tid_lock, "tid");
+  for (i = 0; i < CPU_MAX; i++)
+    ready_queue_init (&ready_queues[i]);
   list_init (&all_list);
+  list_init (&thread_cache);
+  list_init (&reap_list);
 
   load_avg = FIXED_POINT(0);
   first_init_thread = true;
@@ -117,6 +306,63 @@ thread_init (void)
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
   first_init_thread = false;
+
+  /* We are running on the bootstrap processor. */
+  cpus[0].id = 0;
+  cpus[0].started = true;
+  cpus[0].current = initial_thread;
+}
+
+/* Prepares the idle thread of application processor CPU, which
+   is not running yet, and returns the top of its stack.  The
+   processor starts out running on that stack and enters
+   thread_start_ap(). */
+void *
+thread_prepare_ap (struct cpu *cpu)
+{
+  struct thread *t;
+  char name[16];
+
+  t = palloc_get_page (PAL_ZERO);
+  if (t == NULL)
+    PANIC ("out of memory starting CPU %d", cpu->id);
+
+  snprintf (name, sizeof name, "idle%d", cpu->id);
+  init_thread (t, name, PRI_MIN);
+  t->tid = allocate_tid ();
+  t->cpu = cpu;
+  return t->stack;
+}
+
+/* Called on an application processor, with interrupts off, once
+   it is ready to take part in scheduling.  Turns the code that is
+   running into the processor's idle thread. */
+void
+thread_start_ap (void)
+{
+  struct thread *t = running_thread ();
+  struct cpu *cpu = t->cpu;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (is_thread (t));
+
+  t->status = THREAD_RUNNING;
+  cpu->idle_thread = t;
+  cpu->current = t;
+  cpu->mlfqs_epoch = mlfqs_epoch;
+  cpu->started = true;
+  idle_loop ();
+}
+
+/* Returns the CPU that is executing this code. */
+struct cpu *
+cpu_current (void)
+{
+  struct thread *t = running_thread ();
+
+  /* Before thread_init() there is no thread structure yet, but
+     then only the bootstrap processor is running. */
+  return is_thread (t) ? t->cpu : &cpus[0];
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -134,13 +380,59 @@ thread_start (void)
 
   /* Wait for the idle thread to initialize idle_thread. */
   sema_down (&idle_started);
+
+  /* Create the thread that frees dead threads' pages. */
+  thread_create ("reaper", PRI_MIN, reaper, NULL);
+
+  /* Create the thread that runs RCU grace periods. */
+  rcu_init ();
 }
 
-void
-thread_calculate_recent_cpu (struct thread *t)
+/* Brings T's recent_cpu up to date with the current MLFQS epoch by
+   applying every decay T missed since it was last examined.  The
+   last DECAY_HISTORY epochs are replayed exactly; anything older
+   is folded in at once assuming the oldest recorded coefficient,
+   which keeps the cost bounded for long sleepers. */
+static void
+thread_refresh_recent_cpu (struct thread *t)
 {
-  t->recent_cpu = ADD_INT (MUL (DIV (2 * load_avg, ADD_INT (2 * load_avg, 1)),
-                     t->recent_cpu), t->nice);
+  unsigned missed = mlfqs_epoch - t->recent_cpu_epoch;
+  unsigned epoch;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (missed == 0)
+    return;
+  if (missed > DECAY_HISTORY)
+    {
+      /* Iterating recent_cpu = c * recent_cpu + nice for N epochs
+         gives c^N * recent_cpu + nice * (1 - c^N) / (1 - c). */
+      real c = decay_history[mlfqs_epoch % DECAY_HISTORY];
+      real c_n = decay_power (c, missed - DECAY_HISTORY);
+      t->recent_cpu = MUL (c_n, t->recent_cpu)
+                      + DIV (MUL_INT (FIXED_POINT (1) - c_n, t->nice),
+                             FIXED_POINT (1) - c);
+      missed = DECAY_HISTORY;
+    }
+  for (epoch = mlfqs_epoch - missed; epoch != mlfqs_epoch; epoch++)
+    t->recent_cpu = ADD_INT (MUL (decay_history[epoch % DECAY_HISTORY],
+                                  t->recent_cpu), t->nice);
+  t->recent_cpu_epoch = mlfqs_epoch;
+}
+
+/* Returns the fixed point number C raised to the N'th power. */
+static real
+decay_power (real c, unsigned n)
+{
+  real result = FIXED_POINT (1);
+
+  for (; n > 0; n >>= 1)
+    {
+      if (n & 1)
+        result = MUL (result, c);
+      c = MUL (c, c);
+    }
+  return result;
 }
 
 /* Called by the timer interrupt handler at each timer tick.
@@ -151,7 +443,8 @@ thread_tick (void)
   struct thread *t = thread_current ();
 
   /* Update statistics. */
-  if (t == idle_thread)
+  t->cpu->ticks++;
+  if (t == t->cpu->idle_thread)
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
@@ -164,9 +457,37 @@ thread_tick (void)
       case MLFQ_SCHEDULER:
         thread_tick_mlfqs ();
         break;
+      case FAIR_SCHEDULER:
+        thread_tick_fair ();
+        break;
       default:
         thread_tick_ps ();
     }
+  thread_tick_edf (t);
+  if (t->rcu_nesting == 0)
+    rcu_quiescent (t->cpu);
+
+  /* An idle CPU looks for work queued on the other CPUs. */
+  if (t == t->cpu->idle_thread && cpu_cnt > 1 && find_victim (t->cpu) != NULL)
+    intr_yield_on_return ();
+}
+
+/* Called by the timer interrupt handler for each timer tick that
+   the bootstrap processor spent idle with its timer interrupt
+   stopped (see timer_idle_enter()).  Does the bookkeeping that
+   thread_tick() would have done for the idle thread. */
+void
+thread_tick_idle (void)
+{
+  struct cpu *cpu = cpu_current ();
+
+  ASSERT (cpu->id == 0);
+
+  cpu->ticks++;
+  idle_ticks++;
+  rcu_quiescent (cpu);
+  if (scheduler == MLFQ_SCHEDULER && timer_ticks () % TIMER_FREQ == 0)
+    mlfqs_new_epoch ();
 }
 
 /* Prints thread statistics. */
@@ -175,19 +496,53 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread cache: %lld hits, %lld misses, %lld reaped\n",
+          cache_hits, cache_misses, reaped);
+  latency_print ("create", &create_latency);
+  latency_print ("exit", &exit_latency);
+  printf ("Real-time: %lld jobs, %lld deadline misses, %lld budget overruns\n",
+          edf_total.jobs, edf_total.misses, edf_total.overruns);
 }
 
-/* Compares the priority of two threads. Used to create an ordered
-   list of the threads based on priority. */
-bool
-priority_comparator (struct list_elem *first, struct list_elem *second, 
-                     void *aux)
+/* Stores the running thread's scheduler statistics into *SS. */
+void
+thread_get_schedstat (struct schedstat *ss)
+{
+  enum intr_level old_level = intr_disable ();
+  *ss = thread_current ()->schedstat;
+  intr_set_level (old_level);
+}
+
+/* Stores the system-wide scheduler statistics into *SS and, if
+   they are nonnull, the histograms of run queue waits into *WAIT
+   and of running times into *RUN. */
+void
+thread_get_schedstat_total (struct schedstat *ss, struct schedstat_hist *wait,
+                            struct schedstat_hist *run)
+{
+  enum intr_level old_level = intr_disable ();
+  *ss = schedstat_total;
+  if (wait != NULL)
+    *wait = wait_hist;
+  if (run != NULL)
+    *run = run_hist;
+  intr_set_level (old_level);
+}
+
+/* Prints the system-wide scheduler statistics. */
+void
+thread_print_schedstat (void)
 {
-  if (second == NULL)
-    return first != NULL;
-  struct thread *first_thread = list_entry (first, struct thread, elem);
-  struct thread *second_thread = list_entry (second, struct thread, elem);
-  return first_thread->priority > second_thread->priority;
+  struct schedstat ss;
+  struct schedstat_hist wait, run;
+
+  thread_get_schedstat_total (&ss, &wait, &run);
+  printf ("Schedstat: %lld voluntary switches, %lld involuntary switches, "
+          "%lld runs\n", ss.nvcsw, ss.nivcsw, ss.runs);
+  printf ("Schedstat: %lld ns waiting, %lld ns running\n",
+          (long long) ss.wait_ns, (long long) ss.run_ns);
+  hist_print ("run queue wait", &wait);
+  hist_print ("run time", &run);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -215,11 +570,12 @@ thread_create (const char *name, int priority,
   struct switch_threads_frame *sf;
   tid_t tid;
   enum intr_level old_level;
+  int64_t start = clock_ns ();
 
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_get ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -247,6 +603,7 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
   sf->ebp = 0;
 
+  latency_add (&create_latency, clock_ns () - start);
   intr_set_level (old_level);
 
   /* Add to run queue. */
@@ -270,6 +627,14 @@ thread_block (void)
   
   if (scheduler == MLFQ_SCHEDULER)
     thread_calculate_priority (thread_current ());
+  else if (scheduler == FAIR_SCHEDULER)
+    {
+      /* Keep our virtual runtime relative to the floor while
+         blocked. */
+      struct thread *cur = thread_current ();
+      fair_update_curr (cur);
+      cur->vruntime -= cpu_ready_queue (cur->cpu)->min_vruntime;
+    }
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -291,8 +656,20 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_insert_ordered (&ready_list, &t->elem, priority_comparator, NULL);
+  if (scheduler == FAIR_SCHEDULER)
+    {
+      /* Place T relative to this CPU's floor, with limited
+         credit for the time it slept. */
+      if (t->vruntime < -FAIR_LATENCY_NS / 2)
+        t->vruntime = -FAIR_LATENCY_NS / 2;
+      t->vruntime += cpu_ready_queue (cpu_current ())->min_vruntime;
+    }
+  ready_queue_push (cpu_ready_queue (cpu_current ()), t);
+  t->cpu = cpu_current ();
   t->status = THREAD_READY;
+  t->ready_since = clock_ns ();
+  if (cpu_cnt > 1)
+    kick_idle_cpu ();
   intr_set_level (old_level);
 }
 
@@ -336,9 +713,13 @@ thread_exit (void)
 {
   ASSERT (!intr_context ());
 
+  thread_current ()->exit_start = clock_ns ();
 #ifdef USERPROG
   process_exit ();
 #endif
+  thread_clear_periodic ();
+  fpu_thread_exit ();
+  malloc_thread_exit ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -360,28 +741,153 @@ thread_yield (void)
 
   ASSERT (!intr_context ());
   old_level = intr_disable ();
-  if (cur != idle_thread)
-    list_insert_ordered (&ready_list, &cur->elem, priority_comparator, NULL);
+  if (cur->edf.throttled)
+    {
+      /* Out of budget: sit out until the next release. */
+      thread_block ();
+      intr_set_level (old_level);
+      return;
+    }
+  if (scheduler == FAIR_SCHEDULER)
+    fair_update_curr (cur);
+  if (!is_idle_thread (cur))
+    ready_queue_push (cpu_ready_queue (cur->cpu), cur);
   cur->status = THREAD_READY;
+  cur->ready_since = clock_ns ();
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU on behalf of an interrupt handler that called
+   intr_yield_on_return(), just before the interrupt returns.
+   Unlike thread_yield(), counts as an involuntary switch.  A
+   thread in an RCU read-side critical section is preempted when
+   it leaves it instead. */
+void
+thread_preempt (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->rcu_nesting > 0)
+    {
+      cur->rcu_preempt_pending = true;
+      return;
+    }
+  cur->preempted = true;
+  thread_yield ();
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
-   This function must be called with interrupts off. */
+   The threads are visited in an RCU read-side critical section,
+   so interrupts may be on, but FUNC must not sleep.  A thread
+   that exits meanwhile may or may not be visited. */
 void
 thread_foreach (thread_action_func *func, void *aux)
 {
   struct list_elem *e;
 
-  ASSERT (intr_get_level () == INTR_OFF);
-
+  rcu_read_lock ();
   for (e = list_begin (&all_list); e != list_end (&all_list);
        e = list_next (e))
     {
       struct thread *t = list_entry (e, struct thread, allelem);
       func (t, aux);
     }
+  rcu_read_unlock ();
+}
+
+/* Makes the running thread periodic, in the earliest-deadline-
+   first real-time class: every PERIOD timer ticks, starting now,
+   it is released with BUDGET ticks of CPU time to be used within
+   DEADLINE ticks.  Returns true if successful, false if admitting
+   it would overload the system, in which case the thread keeps
+   its previous parameters.  A periodic thread may call this
+   again to change its parameters. */
+bool
+thread_set_periodic (int64_t period, int64_t budget, int64_t deadline)
+{
+  struct thread *cur = thread_current ();
+  struct edf_task *e = &cur->edf;
+  enum intr_level old_level;
+  long util, old_util;
+  int64_t now;
+
+  ASSERT (!is_idle_thread (cur));
+  ASSERT (0 < budget && budget <= deadline && deadline <= period);
+
+  util = edf_density (budget, deadline);
+  old_level = intr_disable ();
+  old_util = e->periodic ? edf_density (e->budget, e->rel_deadline) : 0;
+  if (edf_util - old_util + util > EDF_UTIL_MAX)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  edf_util += util - old_util;
+
+  now = timer_ticks ();
+  e->periodic = true;
+  e->period = period;
+  e->budget = budget;
+  e->rel_deadline = deadline;
+  e->deadline = now + deadline;
+  e->next_release = now + period;
+  e->used = 0;
+  e->done = false;
+  timer_event_arm (&e->release, e->next_release);
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Returns the running thread to the normal scheduling class, if
+   it is periodic. */
+void
+thread_clear_periodic (void)
+{
+  struct edf_task *e = &thread_current ()->edf;
+  enum intr_level old_level = intr_disable ();
+
+  if (e->periodic)
+    {
+      timer_event_cancel (&e->release);
+      edf_util -= edf_density (e->budget, e->rel_deadline);
+      e->periodic = false;
+    }
+  intr_set_level (old_level);
+}
+
+/* Completes the running periodic thread's current job and
+   sleeps until the next one is released. */
+void
+thread_wait_period (void)
+{
+  struct edf_task *e = &thread_current ()->edf;
+  enum intr_level old_level;
+
+  ASSERT (e->periodic);
+
+  old_level = intr_disable ();
+  e->stats.jobs++;
+  edf_total.jobs++;
+  if (timer_ticks () > e->deadline)
+    {
+      e->stats.misses++;
+      edf_total.misses++;
+    }
+  e->done = true;
+  e->waiting = true;
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Stores the running thread's real-time job counters into
+   *STATS. */
+void
+thread_get_edf_stats (struct edf_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = thread_current ()->edf.stats;
+  intr_set_level (old_level);
 }
 
 /* Sets the current thread's priority to NEW_PRIORITY. */
@@ -394,7 +900,6 @@ thread_set_priority (int new_priority)
     {
       thread_current ()->priority = new_priority;
       thread_current ()->real_priority = FIXED_POINT(new_priority);
-      priority_sort_ready_list ();
     }
   thread_current ()->orig_priority = new_priority;
   intr_set_level (old_level);
@@ -413,11 +918,23 @@ void
 thread_set_nice (int new_nice)
 {
   enum intr_level old_level = intr_disable ();
+  struct thread *cur = thread_current ();
+
+  if (scheduler == FAIR_SCHEDULER)
+    {
+      fair_update_curr (cur);
+      cur->nice = new_nice;
+      cur->weight = fair_weight (new_nice);
+      if (fair_should_preempt (cur))
+        thread_yield ();
+      intr_set_level (old_level);
+      return;
+    }
+  thread_refresh_recent_cpu (thread_current ());
   thread_current ()->nice = new_nice;
   thread_calculate_priority (thread_current ());
-  if (!list_empty (&ready_list) 
-        && thread_get_priority () 
-      < list_entry (list_front (&ready_list), struct thread, elem)->priority)
+  if (thread_get_priority ()
+      < ready_queue_max_priority (cpu_ready_queue (cpu_current ())))
     thread_yield();
   intr_set_level (old_level);
 }
@@ -440,55 +957,140 @@ thread_get_load_avg (void)
 int
 thread_get_recent_cpu (void)
 {
-  return ROUND (100 * thread_current ()->recent_cpu);
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu;
+
+  thread_refresh_recent_cpu (thread_current ());
+  recent_cpu = ROUND (100 * thread_current ()->recent_cpu);
+  intr_set_level (old_level);
+  return recent_cpu;
 }
 
+/* Sets the effective priority of T to PRIORITY.  If T is in the
+   run queue it is moved to the back of its new priority level,
+   which takes constant time. */
 void
-thread_calculate_priority (struct thread *t)
+thread_update_priority (struct thread *t, int priority)
 {
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  old_level = intr_disable ();
+  if (t->status == THREAD_READY && !is_idle_thread (t)
+      && t->priority != priority)
+    {
+      ready_queue_remove (cpu_ready_queue (t->cpu), t);
+      t->priority = priority;
+      ready_queue_push (cpu_ready_queue (t->cpu), t);
+    }
+  else
+    t->priority = priority;
+  intr_set_level (old_level);
+}
+
+/* Computes T's MLFQS priority from its nice and recent_cpu values,
+   stores the unrounded value in T's real_priority and returns the
+   priority clamped to PRI_MIN..PRI_MAX. */
+static int
+thread_mlfqs_priority (struct thread *t)
+{
+  int priority;
+
   t->real_priority = FIXED_POINT (PRI_MAX - t->nice * 2) - t->recent_cpu / 4;
-  t->priority = INTEGER (t->real_priority);
-  sort_sema_waiters (t->waiting_sema);
-  sort_condvar_waiters(t->waiting_condvar);
-  if (t->waiting_lock != NULL)
-    sort_sema_waiters (&t->waiting_lock->semaphore);
+  priority = INTEGER (t->real_priority);
+  if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  else if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  return priority;
+}
+
+void
+thread_calculate_priority (struct thread *t)
+{
+  int old_priority = t->priority;
+
+  thread_update_priority (t, thread_mlfqs_priority (t));
+  synch_priority_changed (t, old_priority);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it initializes the bootstrap processor's idle_thread,
+   "up"s the semaphore passed to it to enable thread_start() to
+   continue, and immediately blocks.  After that, the idle thread
+   never appears in the ready list.  It is returned by
+   next_thread_to_run() as a special case when there is nothing
+   else to run.  Application processors get their idle threads
+   from thread_start_ap() instead. */
 static void
 idle (void *idle_started_ UNUSED)
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  cpu_current ()->idle_thread = thread_current ();
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/* Body of every idle thread. */
+static void
+idle_loop (void)
+{
   for (;;)
     {
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
 
-      /* Re-enable interrupts and wait for the next one.
+      /* Zero free pages for the page allocator while there is
+         nothing else to do.  If a thread becomes ready meanwhile,
+         we are preempted like any other thread. */
+      intr_enable ();
+      while (palloc_zero_idle ())
+        continue;
+      intr_disable ();
+
+      /* Stop the timer tick if nothing needs it, then re-enable
+         interrupts and wait for the next one. */
+      timer_idle_enter ();
+      intr_wait ();
+    }
+}
 
-         The `sti' instruction disables interrupts until the
-         completion of the next instruction, so these two
-         instructions are executed atomically.  This atomicity is
-         important; otherwise, an interrupt could be handled
-         between re-enabling interrupts and waiting for the next
-         one to occur, wasting as much as one clock tick worth of
-         time.
+/* Returns true if T is the idle thread of its CPU. */
+static bool
+is_idle_thread (struct thread *t)
+{
+  return t->cpu != NULL && t == t->cpu->idle_thread;
+}
 
-         See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+/* Reaper thread.  Returns the pages of dead threads that did not
+   fit in the thread cache to the page allocator, which cannot be
+   done on the context-switch path because it takes a lock. */
+static void
+reaper (void *aux UNUSED)
+{
+  reaper_thread = thread_current ();
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      struct thread *t;
+
+      while (list_empty (&reap_list))
+        {
+          reaper_waiting = true;
+          thread_block ();
+        }
+      t = list_entry (list_pop_front (&reap_list), struct thread, elem);
+      reaped++;
+      intr_set_level (old_level);
+
+      palloc_free_page (t);
     }
 }
 
@@ -549,19 +1151,25 @@ init_thread (struct thread *t, const char *name, int priority)
   t->waiting_lock = NULL;
   t->waiting_sema = NULL;
   t->waiting_condvar = NULL;
-  t->wakeup_time = 0;
+  t->waiting_cond_elem = NULL;
+  t->waiting_rwlock = NULL;
+  t->recent_cpu_epoch = mlfqs_epoch;
   if (first_init_thread)
     {
+      t->cpu = &cpus[0];
       t->recent_cpu = FIXED_POINT(0);
       t->nice = 0;
     }
   else
     {
+      t->cpu = thread_current ()->cpu;
       t->recent_cpu = thread_current ()->recent_cpu;
       t->nice = thread_current ()->nice;
     }
+  t->weight = fair_weight (t->nice);
+  timer_event_init (&t->edf.release, edf_release, t);
   list_init (&t->acquired_locks);
-  list_push_back (&all_list, &t->allelem);
+  rcu_list_push_back (&all_list, &t->allelem);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -577,18 +1185,231 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Returns a page for a new thread, or a null pointer if none is
+   available.  Prefers recycled pages, even those still waiting
+   for the reaper, to fresh ones from the page allocator. */
 static struct thread *
-next_thread_to_run (void)
+thread_page_get (void)
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (!list_empty (&thread_cache))
+    {
+      t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+      thread_cache_cnt--;
+    }
+  else if (!list_empty (&reap_list))
+    t = list_entry (list_pop_front (&reap_list), struct thread, elem);
+  if (t != NULL)
+    cache_hits++;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    cache_misses++;
+  intr_set_level (old_level);
+
+  return t != NULL ? t : palloc_get_page (0);
+}
+
+/* Recycles the page of a dead thread once a grace period has
+   passed since it was removed from all_list, so that
+   thread_foreach() does not find the page reused. */
+static void
+thread_page_reclaim (struct rcu_head *head)
+{
+  struct thread *t = rcu_entry (head, struct thread, rcu);
+  enum intr_level old_level = intr_disable ();
+
+  thread_page_put (t);
+  intr_set_level (old_level);
+}
+
+/* Recycles the page of dead thread T: keeps it in the thread
+   cache if there is room, otherwise hands it to the reaper.
+   Interrupts must be off. */
+static void
+thread_page_put (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  latency_add (&exit_latency, clock_ns () - t->exit_start);
+  t->magic = 0;
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    {
+      list_push_front (&thread_cache, &t->elem);
+      thread_cache_cnt++;
+    }
+  else
+    {
+      list_push_back (&reap_list, &t->elem);
+      if (reaper_waiting)
+        {
+          reaper_waiting = false;
+          thread_unblock (reaper_thread);
+        }
+    }
+}
+
+/* Adds a sample of NS nanoseconds to latency statistics L.  Must
+   be called with interrupts off. */
+static void
+latency_add (struct latency *l, int64_t ns)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  l->count++;
+  l->total += ns;
+  if (ns > l->max)
+    l->max = ns;
+}
+
+/* Prints latency statistics L under NAME. */
+static void
+latency_print (const char *name, const struct latency *l)
+{
+  printf ("Thread %s latency: %lld samples, %lld ns avg, %lld ns max\n",
+          name, l->count, l->count > 0 ? l->total / l->count : 0, l->max);
+}
+
+/* Accounts for switching T out at time NOW. */
+static void
+schedstat_switch_out (struct thread *t, int64_t now)
+{
+  int64_t ran = now - t->run_start;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (is_idle_thread (t))
+    return;
+  if (t->preempted)
+    {
+      t->schedstat.nivcsw++;
+      schedstat_total.nivcsw++;
+    }
+  else
+    {
+      t->schedstat.nvcsw++;
+      schedstat_total.nvcsw++;
+    }
+  t->preempted = false;
+  t->schedstat.run_ns += ran;
+  schedstat_total.run_ns += ran;
+  hist_add (&run_hist, ran);
+}
+
+/* Accounts for T starting to run at time NOW, after waiting in a
+   run queue since T->ready_since. */
+static void
+schedstat_switch_in (struct thread *t, int64_t now)
+{
+  int64_t waited = now - t->ready_since;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->preempted = false;
+  t->run_start = now;
+  if (is_idle_thread (t))
+    return;
+  t->schedstat.runs++;
+  schedstat_total.runs++;
+  t->schedstat.wait_ns += waited;
+  schedstat_total.wait_ns += waited;
+  hist_add (&wait_hist, waited);
+}
+
+/* Adds a sample of NS nanoseconds to histogram H. */
+static void
+hist_add (struct schedstat_hist *h, int64_t ns)
+{
+  int bucket = ns > 0 ? highest_set_bit (ns) : 0;
+
+  if (bucket >= SCHEDSTAT_BUCKETS)
+    bucket = SCHEDSTAT_BUCKETS - 1;
+  h->buckets[bucket]++;
+}
+
+/* Prints the non-empty buckets of histogram H under NAME. */
+static void
+hist_print (const char *name, const struct schedstat_hist *h)
+{
+  int i;
+
+  printf ("Schedstat: %s histogram (ns):\n", name);
+  for (i = 0; i < SCHEDSTAT_BUCKETS; i++)
+    if (h->buckets[i] != 0)
+      printf ("  %10lld .. %10lld: %lld\n",
+              i > 0 ? 1LL << i : 0LL, (2LL << i) - 1, h->buckets[i]);
+}
+
+/* Chooses and returns the next thread to be scheduled on CPU.
+   Should return a thread from CPU's run queue, unless that queue
+   is empty.  (If the running thread can continue running, then it
+   will be in the run queue.)  If it is empty, steal a thread from
+   another CPU, and if there is nothing to steal, return CPU's
+   idle thread. */
+static struct thread *
+next_thread_to_run (struct cpu *cpu)
+{
+  struct thread *t = ready_queue_pop (cpu_ready_queue (cpu));
+
+  if (t == NULL && cpu_cnt > 1)
+    {
+      struct cpu *victim = find_victim (cpu);
+      if (victim != NULL)
+        {
+          struct ready_queue *victim_rq = cpu_ready_queue (victim);
+
+          t = ready_queue_pop (victim_rq);
+          if (scheduler == FAIR_SCHEDULER)
+            t->vruntime += (cpu_ready_queue (cpu)->min_vruntime
+                            - victim_rq->min_vruntime);
+        }
+    }
+  return t != NULL ? t : cpu->idle_thread;
+}
+
+/* Returns the started CPU other than THIEF with the longest
+   non-empty run queue, or a null pointer if there is none. */
+static struct cpu *
+find_victim (struct cpu *thief)
+{
+  struct cpu *victim = NULL;
+  int victim_size = 0;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *c = &cpus[i];
+      int size = ready_queue_size (cpu_ready_queue (c));
+
+      if (c != thief && c->started && size > victim_size)
+        {
+          victim = c;
+          victim_size = size;
+        }
+    }
+  return victim;
+}
+
+/* Sends a reschedule IPI to one idle CPU, if there is one, so
+   that it steals the thread that was just made ready. */
+static void
+kick_idle_cpu (void)
+{
+  struct cpu *self = cpu_current ();
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *c = &cpus[i];
+      if (c != self && c->started && c->current == c->idle_thread)
+        {
+          smp_send_reschedule (c);
+          return;
+        }
+    }
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -611,6 +1432,7 @@ void
 thread_schedule_tail (struct thread *prev)
 {
   struct thread *cur = running_thread ();
+  int64_t now;
 
   ASSERT (intr_get_level () == INTR_OFF);
 
@@ -618,23 +1440,29 @@ thread_schedule_tail (struct thread *prev)
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  now = clock_ns ();
+  cur->cpu->thread_ticks = 0;
+  cur->exec_start = now;
+  schedstat_switch_in (cur, now);
+  fpu_switch (prev);
 
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
 #endif
 
-  /* If the thread we switched from is dying, destroy its struct
-     thread.  This must happen late so that thread_exit() doesn't
-     pull out the rug under itself.  (We don't free
-     initial_thread because its memory was not obtained via
-     palloc().) */
+  /* If the thread we switched from is dying, recycle its page.
+     This must happen late so that thread_exit() doesn't pull out
+     the rug under itself.  (We don't recycle initial_thread
+     because its memory was not obtained via palloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      call_rcu (&prev->rcu, thread_page_reclaim);
     }
+
+  /* Switching threads is a quiescent state. */
+  rcu_quiescent (cur->cpu);
 }
 
 /* Schedules a new process.  At entry, interrupts must be off and
@@ -648,13 +1476,22 @@ static void
 schedule (void)
 {
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct cpu *cpu = cur->cpu;
+  struct thread *next = next_thread_to_run (cpu);
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
+  ASSERT (cur->rcu_nesting == 0);
   ASSERT (is_thread (next));
 
+  if (cur == cpu->idle_thread && next != cur)
+    timer_idle_exit ();
+  next->cpu = cpu;
+  cpu->current = next;
+  if (cur != next)
+    schedstat_switch_out (cur, clock_ns ());
+
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
@@ -682,7 +1519,7 @@ allocate_tid (void)
 static void
 thread_tick_ps (void)
 {
-  if (++thread_ticks >= TIME_SLICE)
+  if (++cpu_current ()->thread_ticks >= TIME_SLICE)
         intr_yield_on_return ();
 }
 
@@ -690,38 +1527,71 @@ thread_tick_ps (void)
    also it updates the load_avg every one second (every 100 timer ticks) and
    the recent_cpu every timer tick.
 
+   Blocked threads are not touched here: a new epoch is started
+   every second and they catch up on the decays they missed when
+   they are unblocked.  Only the running and ready threads, whose
+   priorities decide what runs next, are brought up to date.  The
+   bootstrap processor starts the epochs; every CPU then refreshes
+   at most MLFQS_REFRESH_BATCH of its ready threads per tick, so
+   that a tick takes the same time however many threads there
+   are.
+
    NOTE: This function is used for doing this check and update every
    time tick with the Multi-level Feedback Queue Scheduler(MLFQS). */
 static void
 thread_tick_mlfqs (void)
 {
-  if (thread_current () != idle_thread)
-      thread_current ()->recent_cpu = ADD_INT(thread_current ()->recent_cpu, 1);
+  struct thread *cur = thread_current ();
+  struct cpu *cpu = cur->cpu;
+  struct ready_queue *rq = cpu_ready_queue (cpu);
+
+  thread_refresh_recent_cpu (cur);
+  if (cur != cpu->idle_thread)
+      cur->recent_cpu = ADD_INT(cur->recent_cpu, 1);
 
   // One second has passed.
-  if (timer_ticks () % TIMER_FREQ == 0)
-    {
-      int ready_threads = list_size (&ready_list);
-      if (thread_current () != idle_thread)
-        ready_threads++;
-      load_avg = MUL(load_avg, DIV(59, 60)) + DIV(ready_threads, 60);
-      thread_foreach (&thread_calculate_recent_cpu, NULL);
-      thread_foreach (&thread_calculate_priority, NULL);
-      priority_sort_ready_list ();
-    }
+  if (cpu->id == 0 && timer_ticks () % TIMER_FREQ == 0)
+    mlfqs_new_epoch ();
 
-  if (timer_ticks () % 4 == 0)
+  if (cpu->mlfqs_epoch != mlfqs_epoch)
     {
-      thread_calculate_priority (thread_current ());
-      priority_sort_ready_list ();
+      cpu->mlfqs_epoch = mlfqs_epoch;
+      thread_refresh_recent_cpu (cur);
+      thread_calculate_priority (cur);
+      rq->stale = rq->occupied;
     }
+  ready_queue_refresh_mlfqs (rq, MLFQS_REFRESH_BATCH);
+
+  if (cpu->ticks % 4 == 0)
+    thread_calculate_priority (thread_current ());
+
   /* Preempt running thread if its time slice has passed, or a higher priority thread is ready */
-  if (++thread_ticks >= TIME_SLICE || (!list_empty (&ready_list) 
-      && thread_current ()->priority 
-    < list_entry (list_front (&ready_list), struct thread, elem)->priority))
+  if (++cpu->thread_ticks >= TIME_SLICE
+      || thread_current ()->priority < ready_queue_max_priority (rq))
     intr_yield_on_return ();
 }
 
+/* Updates load_avg and starts a new MLFQS epoch.  Called on the
+   bootstrap processor once per second. */
+static void
+mlfqs_new_epoch (void)
+{
+  int ready_threads = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].started)
+      {
+        ready_threads += ready_queue_size (cpu_ready_queue (&cpus[i]));
+        if (cpus[i].current != cpus[i].idle_thread)
+          ready_threads++;
+      }
+  load_avg = MUL(load_avg, DIV(59, 60)) + DIV(ready_threads, 60);
+  decay_history[mlfqs_epoch % DECAY_HISTORY]
+    = DIV (2 * load_avg, ADD_INT (2 * load_avg, 1));
+  mlfqs_epoch++;
+}
+
 /* Handles the thread initialization part required when using
    Priority Scheduler(PS). */
 static void
@@ -737,17 +1607,376 @@ init_thread_ps (struct thread *t, int priority)
 static void
 init_thread_mlfqs (struct thread *t)
 {
-  thread_calculate_priority (t);
+  t->priority = thread_mlfqs_priority (t);
   t->orig_priority = INTEGER(t->real_priority);
 }
+
+/* Charges the running thread for its time on the CPU and
+   preempts it once it has had its share of the CPU, if another
+   thread is owed the CPU more.  Fair-share counterpart of
+   thread_tick_ps(). */
+static void
+thread_tick_fair (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (is_idle_thread (cur))
+    return;
+  fair_update_curr (cur);
+  if (fair_should_preempt (cur))
+    intr_yield_on_return ();
+}
+
+/* Returns the fair-share weight of a thread with the given NICE
+   value. */
+static int
+fair_weight (int nice)
+{
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+  return fair_weights[nice - NICE_MIN];
+}
+
+/* Advances the virtual runtime of T, which must be running, by
+   the time it ran since it was last charged, and moves its run
+   queue's floor up accordingly. */
+static void
+fair_update_curr (struct thread *t)
+{
+  struct ready_queue *rq = cpu_ready_queue (t->cpu);
+  struct rb_elem *first;
+  int64_t now = clock_ns ();
+  int64_t floor;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (is_idle_thread (t))
+    return;
+  t->vruntime += (now - t->exec_start) * NICE_0_WEIGHT / t->weight;
+  t->exec_start = now;
+
+  floor = t->vruntime;
+  first = rb_first (&rq->fair);
+  if (first != NULL
+      && rb_entry (first, struct thread, fair_elem)->vruntime < floor)
+    floor = rb_entry (first, struct thread, fair_elem)->vruntime;
+  if (floor > rq->min_vruntime)
+    rq->min_vruntime = floor;
+}
+
+/* Returns true if running thread T has used up its share of
+   FAIR_LATENCY_NS and a thread with a smaller virtual runtime is
+   waiting in its run queue. */
+static bool
+fair_should_preempt (struct thread *t)
+{
+  struct ready_queue *rq = cpu_ready_queue (t->cpu);
+  struct rb_elem *first = rb_first (&rq->fair);
+  int64_t slice;
+
+  if (first == NULL
+      || rb_entry (first, struct thread, fair_elem)->vruntime >= t->vruntime)
+    return false;
+
+  slice = (int64_t) FAIR_LATENCY_NS * t->weight / (rq->load + t->weight);
+  if (slice < FAIR_MIN_GRANULARITY_NS)
+    slice = FAIR_MIN_GRANULARITY_NS;
+  return clock_ns () - t->run_start >= slice;
+}
+
+/* Returns true if thread A_ has a smaller virtual runtime than
+   thread B_, false otherwise. */
+static bool
+fair_less (const struct rb_elem *a_, const struct rb_elem *b_,
+           void *aux UNUSED)
+{
+  const struct thread *a = rb_entry (a_, struct thread, fair_elem);
+  const struct thread *b = rb_entry (b_, struct thread, fair_elem);
+
+  return a->vruntime < b->vruntime;
+}
 
+/* Charges running thread CUR for a tick against its real-time
+   budget, throttling it once the budget is used up, and preempts
+   it if a real-time thread with an earlier deadline is ready on
+   its CPU.  Called for every scheduler. */
+static void
+thread_tick_edf (struct thread *cur)
+{
+  struct rb_elem *first = rb_first (&cpu_ready_queue (cur->cpu)->edf);
+
+  if (cur->edf.periodic && ++cur->edf.used >= cur->edf.budget)
+    {
+      cur->edf.throttled = true;
+      cur->edf.stats.overruns++;
+      edf_total.overruns++;
+      intr_yield_on_return ();
+    }
+  else if (first != NULL
+           && edf_preempts (rb_entry (first, struct thread, edf.elem), cur))
+    intr_yield_on_return ();
+}
+
+/* Timer event that releases the next job of periodic thread T_:
+   replenishes its budget, moves its deadline and wakes it up if
+   it was waiting for the release or throttled. */
+static void
+edf_release (void *t_)
+{
+  struct thread *t = t_;
+  struct edf_task *e = &t->edf;
+  bool queued = t->status == THREAD_READY;
+
+  if (!e->done)
+    {
+      /* The unfinished job runs on as the new one. */
+      e->stats.misses++;
+      edf_total.misses++;
+    }
+
+  /* Requeue T under its new deadline. */
+  if (queued)
+    ready_queue_remove (cpu_ready_queue (t->cpu), t);
+  e->deadline = e->next_release + e->rel_deadline;
+  e->next_release += e->period;
+  e->used = 0;
+  e->done = false;
+  timer_event_arm (&e->release, e->next_release);
+  if (queued)
+    ready_queue_push (cpu_ready_queue (t->cpu), t);
+  else if (e->waiting || e->throttled)
+    {
+      e->waiting = e->throttled = false;
+      thread_unblock (t);
+    }
+
+  if (t->status == THREAD_READY && t->cpu == cpu_current ()
+      && edf_preempts (t, thread_current ()))
+    intr_yield_on_return ();
+}
+
+/* Returns true if ready thread T, which must be periodic, should
+   run instead of running thread CUR. */
+static bool
+edf_preempts (const struct thread *t, const struct thread *cur)
+{
+  return !cur->edf.periodic || t->edf.deadline < cur->edf.deadline;
+}
+
+/* Returns the density of a periodic thread with the given BUDGET
+   and relative DEADLINE, in units of 1 / EDF_UTIL_SCALE, rounded
+   up. */
+static long
+edf_density (int64_t budget, int64_t deadline)
+{
+  return DIV_ROUND_UP (budget * EDF_UTIL_SCALE, deadline);
+}
+
+/* Returns true if thread A_ has an earlier deadline than thread
+   B_, false otherwise. */
+static bool
+edf_less (const struct rb_elem *a_, const struct rb_elem *b_,
+          void *aux UNUSED)
+{
+  const struct thread *a = rb_entry (a_, struct thread, edf.elem);
+  const struct thread *b = rb_entry (b_, struct thread, edf.elem);
+
+  return a->edf.deadline < b->edf.deadline;
+}
+
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
+/* Initializes the run queue RQ to be empty. */
+static void
+ready_queue_init (struct ready_queue *rq)
+{
+  int i;
+
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&rq->levels[i]);
+  rq->occupied = 0;
+  rq->stale = 0;
+  rq->size = 0;
+  rb_init (&rq->fair, fair_less, NULL);
+  rb_init (&rq->edf, edf_less, NULL);
+  rq->min_vruntime = 0;
+  rq->load = 0;
+}
 
-void
-priority_sort_ready_list (void)
+/* Appends T to the back of its priority level in RQ.  Under the
+   MLFQS, first brings T's priority up to date with the current
+   epoch, so that the threads in each level that are not up to
+   date all come before those that are. */
+static void
+ready_queue_push (struct ready_queue *rq, struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (scheduler == MLFQ_SCHEDULER && t->recent_cpu_epoch != mlfqs_epoch)
+    {
+      thread_refresh_recent_cpu (t);
+      t->priority = thread_mlfqs_priority (t);
+    }
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  if (t->edf.periodic)
+    {
+      rb_insert (&rq->edf, &t->edf.elem);
+      rq->size++;
+      return;
+    }
+  if (scheduler == FAIR_SCHEDULER)
+    {
+      rb_insert (&rq->fair, &t->fair_elem);
+      rq->load += t->weight;
+      rq->size++;
+      return;
+    }
+  list_push_back (&rq->levels[t->priority - PRI_MIN], &t->elem);
+  rq->occupied |= (uint64_t) 1 << (t->priority - PRI_MIN);
+  rq->size++;
+}
+
+/* Removes T, which must be queued at level T->priority, from RQ. */
+static void
+ready_queue_remove (struct ready_queue *rq, struct thread *t)
 {
-  list_sort (&ready_list, priority_comparator, NULL);
+  int level = t->priority - PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->edf.periodic)
+    {
+      rb_remove (&rq->edf, &t->edf.elem);
+      rq->size--;
+      return;
+    }
+  if (scheduler == FAIR_SCHEDULER)
+    {
+      rb_remove (&rq->fair, &t->fair_elem);
+      rq->load -= t->weight;
+      rq->size--;
+      return;
+    }
+  list_remove (&t->elem);
+  if (list_empty (&rq->levels[level]))
+    rq->occupied &= ~((uint64_t) 1 << level);
+  rq->size--;
+}
+
+/* Returns the index of the most significant set bit in the
+   non-zero 64-bit value X, using BSR on its two halves. */
+static inline int
+highest_set_bit (uint64_t x)
+{
+  uint32_t hi = x >> 32, lo = x;
+  uint32_t bit;
+
+  ASSERT (x != 0);
+  if (hi != 0)
+    {
+      asm ("bsrl %1, %0" : "=r" (bit) : "rm" (hi));
+      return bit + 32;
+    }
+  asm ("bsrl %1, %0" : "=r" (bit) : "rm" (lo));
+  return bit;
+}
+
+/* Removes and returns the real-time thread with the earliest
+   deadline in RQ, if any, and otherwise the thread at the front
+   of the highest non-empty level of RQ, or a null pointer if RQ
+   is empty. */
+static struct thread *
+ready_queue_pop (struct ready_queue *rq)
+{
+  struct thread *t;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!rb_empty (&rq->edf))
+    {
+      t = rb_entry (rb_first (&rq->edf), struct thread, edf.elem);
+      ready_queue_remove (rq, t);
+      return t;
+    }
+  if (scheduler == FAIR_SCHEDULER)
+    {
+      /* The thread with the smallest virtual runtime is the
+         smallest of all, so the floor can move up to it. */
+      struct rb_elem *e = rb_first (&rq->fair);
+      if (e == NULL)
+        return NULL;
+      t = rb_entry (e, struct thread, fair_elem);
+      ready_queue_remove (rq, t);
+      if (t->vruntime > rq->min_vruntime)
+        rq->min_vruntime = t->vruntime;
+      return t;
+    }
+  if (rq->occupied == 0)
+    return NULL;
+  level = highest_set_bit (rq->occupied);
+  t = list_entry (list_pop_front (&rq->levels[level]), struct thread, elem);
+  if (list_empty (&rq->levels[level]))
+    rq->occupied &= ~((uint64_t) 1 << level);
+  rq->size--;
+  return t;
+}
+
+/* Returns the priority of the highest-priority thread in RQ, or
+   PRI_MIN - 1 if RQ is empty. */
+static int
+ready_queue_max_priority (const struct ready_queue *rq)
+{
+  if (rq->occupied == 0)
+    return PRI_MIN - 1;
+  return highest_set_bit (rq->occupied) + PRI_MIN;
+}
+
+/* Returns CPU's run queue. */
+static struct ready_queue *
+cpu_ready_queue (const struct cpu *cpu)
+{
+  return &ready_queues[cpu->id];
+}
+
+/* Returns the number of threads in RQ. */
+static int
+ready_queue_size (const struct ready_queue *rq)
+{
+  return rq->size;
+}
+
+/* Brings up to date with the current MLFQS epoch the ready
+   threads in RQ that are not, taking at most BUDGET steps.  Each
+   step either refreshes the thread at the front of the highest
+   stale level, requeueing it at the back of its new level, or
+   finds that level up to date and marks it so. */
+static void
+ready_queue_refresh_mlfqs (struct ready_queue *rq, int budget)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (; budget > 0 && rq->stale != 0; budget--)
+    {
+      int level = highest_set_bit (rq->stale);
+      struct list *list = &rq->levels[level];
+      struct thread *t;
+
+      if (!list_empty (list))
+        {
+          t = list_entry (list_front (list), struct thread, elem);
+          if (t->recent_cpu_epoch != mlfqs_epoch)
+            {
+              ready_queue_remove (rq, t);
+              ready_queue_push (rq, t);
+              continue;
+            }
+        }
+      rq->stale &= ~((uint64_t) 1 << level);
+    }
 }
@@ -2,9 +2,17 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
 #include <fixed_point.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/rcu.h"
+#include "threads/synch.h"
+
+struct cpu;
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -24,6 +32,54 @@ typedef int tid_t;
 #define PRI_MIN 0                       /* Lowest priority. */
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1) /* Number of priority levels. */
+
+/* Scheduler statistics, kept for each thread and for the whole
+   system.  Idle threads are not counted. */
+struct schedstat
+  {
+    long long nvcsw;                    /* Voluntary context switches. */
+    long long nivcsw;                   /* Involuntary context switches. */
+    long long runs;                     /* Times the thread was scheduled. */
+    int64_t wait_ns;                    /* Time spent in a run queue. */
+    int64_t run_ns;                     /* Time spent running. */
+  };
+
+/* Log2 histogram of nanosecond latencies.  Bucket I counts the
+   samples from 2**I to 2**(I+1) - 1 ns; bucket 0 also counts 0
+   and the last bucket everything above its range. */
+#define SCHEDSTAT_BUCKETS 32
+struct schedstat_hist
+  {
+    long long buckets[SCHEDSTAT_BUCKETS];
+  };
+
+/* Counters of a periodic real-time thread's jobs. */
+struct edf_stats
+  {
+    long long jobs;                     /* Jobs completed. */
+    long long misses;                   /* Jobs that missed their deadline. */
+    long long overruns;                 /* Jobs throttled for exceeding budget. */
+  };
+
+/* Earliest-deadline-first parameters and state of a periodic
+   real-time thread.  All times are in timer ticks. */
+struct edf_task
+  {
+    bool periodic;                      /* In the real-time class? */
+    int64_t period;                     /* Time between releases. */
+    int64_t budget;                     /* CPU time allowed per job. */
+    int64_t rel_deadline;               /* Deadline relative to release. */
+    int64_t deadline;                   /* Absolute deadline of current job. */
+    int64_t next_release;               /* Release time of next job. */
+    int64_t used;                       /* CPU time used by current job. */
+    bool done;                          /* Current job completed? */
+    bool waiting;                       /* Blocked until next release? */
+    bool throttled;                     /* Out of budget until next release? */
+    struct timer_event release;         /* Fires at NEXT_RELEASE. */
+    struct rb_elem elem;                /* Element in a real-time run queue. */
+    struct edf_stats stats;             /* Job counters. */
+  };
 
 /* A kernel thread or user process.
 
@@ -80,7 +136,8 @@ typedef int tid_t;
    semaphore wait list (synch.c).  It can be used these two ways
    only because they are mutually exclusive: only a thread in the
    ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   blocked state is on a semaphore wait list.  Once a thread is
+   dead, `elem' links its page into thread.c's thread cache. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -93,6 +150,18 @@ struct thread
     int orig_priority;                  /* Original priority of the thread before donation */
     int nice;                           /* Nice value used in calculating BSD Scheduler priority */
     real recent_cpu;                    /* Recent cpu usage estimation used in calculating BSD Scheduler priority */
+    unsigned recent_cpu_epoch;          /* MLFQS epoch recent_cpu is up to date with. */
+    struct cpu *cpu;                    /* CPU running or queueing the thread. */
+    int64_t exit_start;                 /* clock_ns() when thread_exit() was called. */
+    struct schedstat schedstat;         /* Scheduler statistics. */
+    int64_t ready_since;                /* clock_ns() when last made ready. */
+    int64_t run_start;                  /* clock_ns() when last scheduled. */
+    bool preempted;                     /* Being switched out involuntarily? */
+    struct rb_elem fair_elem;           /* Element in a fair-share run queue. */
+    int64_t vruntime;                   /* Fair-share virtual runtime, in ns. */
+    int64_t exec_start;                 /* clock_ns() up to which VRUNTIME is charged. */
+    int weight;                         /* Fair-share weight, from nice. */
+    struct edf_task edf;                /* Real-time scheduling state. */
 
     /* A list of all the acquired locks by the thread.
       Used for thread donation. */
@@ -102,6 +171,23 @@ struct thread
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Owned by synch.c. */
+    struct heap_elem wait_elem;         /* Element in a semaphore's waiters. */
+    unsigned wait_seq;                  /* Arrival order among waiters. */
+
+    /* Owned by rcu.c. */
+    int rcu_nesting;                    /* Depth of RCU read-side sections. */
+    bool rcu_preempt_pending;           /* Preempt on leaving them? */
+    struct rcu_head rcu;                /* Reclaims the page after exit. */
+
+    /* Owned by malloc.c. */
+    struct malloc_magazine malloc_mags[MALLOC_MAG_CLASSES];
+
+    /* Owned by fpu.c. */
+    struct fpu_state *fpu;              /* Saved FPU state, or null. */
+    void *fpu_mem;                      /* Block that FPU is in. */
+    struct cpu *fpu_cpu;                /* CPU that last loaded it. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
@@ -115,24 +201,27 @@ struct thread
     /* A pointer to the condition variable the thread is waiting on
       or NULL if the thread is not waiting on a condition variable */
     struct condition *waiting_condvar;
-    /* Owned by timer.c. */
-    int64_t wakeup_time;                /* Number of timer ticks to wake up at if
-                                           the thread was sleeping. i.e. the thread
-                                           will wake up when timer_ticks() == wakeup_time */
+    /* The thread's element in the waiters of WAITING_CONDVAR. */
+    struct heap_elem *waiting_cond_elem;
+    /* A pointer to the reader-writer lock the thread is waiting on
+      or NULL if it is not waiting on one, and whether it waits to
+      write. */
+    struct rwlock *waiting_rwlock;
+    bool waiting_rwlock_write;
+    /* The reader-writer locks held by the thread.
+      Used for thread donation. */
+    struct rwlock_hold rwlock_holds[RWLOCK_HOLD_MAX];
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
 
-/* Compares two threads and returns true if the priority of the first thread
-   is greater than the priority of the second thread */
-bool priority_comparator (struct list_elem *first, struct list_elem *second, void *aux);
-
 /* Types of supported schedulers. */
 enum scheduler_type
   {
     PRIORITY_SCHEDULER,     /* Priority Scheduler, is the default scheduler. */
-    MLFQ_SCHEDULER   /* Multi-level Feedback Queue Scheduler, like the 4.4BSD Scheduler. */
+    MLFQ_SCHEDULER,  /* Multi-level Feedback Queue Scheduler, like the 4.4BSD Scheduler. */
+    FAIR_SCHEDULER   /* Proportional-share scheduler, like Linux's CFS. */
   };
 
 /* If false (default), use round-robin scheduler.
@@ -145,9 +234,17 @@ extern enum scheduler_type scheduler;
 
 void thread_init (void);
 void thread_start (void);
+void *thread_prepare_ap (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
+void thread_tick_idle (void);
 void thread_print_stats (void);
+void thread_get_schedstat (struct schedstat *);
+void thread_get_schedstat_total (struct schedstat *,
+                                 struct schedstat_hist *wait,
+                                 struct schedstat_hist *run);
+void thread_print_schedstat (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -161,11 +258,17 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
+bool thread_set_periodic (int64_t period, int64_t budget, int64_t deadline);
+void thread_clear_periodic (void);
+void thread_wait_period (void);
+void thread_get_edf_stats (struct edf_stats *);
+
 int thread_get_priority (void);
 void thread_set_priority (int);
 
@@ -173,8 +276,6 @@ int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
-/* Sorts the threads in the ready list in descending
-   order based on priority */
-void priority_sort_ready_list (void);
+void thread_update_priority (struct thread *, int priority);
 
 #endif /* threads/thread.h */
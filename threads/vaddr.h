@@ -40,6 +40,25 @@ static inline void *pg_round_down (const void *va) {
   return (void *) ((uintptr_t) va & ~PGMASK);
 }
 
+/* Copies the page at SRC to DST.  Both must be page-aligned. */
+static inline void pg_copy (void *dst, const void *src) {
+  uint32_t cnt = PGSIZE / sizeof (uint32_t);
+
+  ASSERT (pg_ofs (dst) == 0 && pg_ofs (src) == 0);
+  asm volatile ("rep movsl"
+                : "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+}
+
+/* Fills the page at PAGE, which must be page-aligned, with
+   zeros. */
+static inline void pg_clear (void *page) {
+  uint32_t cnt = PGSIZE / sizeof (uint32_t);
+
+  ASSERT (pg_ofs (page) == 0);
+  asm volatile ("rep stosl"
+                : "+D" (page), "+c" (cnt) : "a" (0) : "memory");
+}
+
 /* Base address of the 1:1 physical-to-virtual mapping.  Physical
    memory is mapped starting at this virtual address.  Thus,
    physical address 0 is accessible at PHYS_BASE, physical